@@ -1,7 +1,26 @@
 set(headers ${headers}
+	src/ActorIndex.h
 	src/Debug.h
+	src/Emitter.h
+	src/Engine.h
+	src/Exposure.h
+	src/Game.h
+	src/HeightCache.h
 	src/Hooks.h
+	src/Jobs.h
+	src/MappedFile.h
 	src/PCH.h
+	src/Particles.h
+	src/RNG.h
+	src/RayBatch.h
+	src/Sampler.h
+	src/Scheduler.h
 	src/Settings.h
+	src/SpanCache.h
+	src/Stats.h
+	src/Surface.h
+	src/Trace.h
+	src/Types.h
 	src/Util.h
+	src/WaterIndex.h
 )
@@ -1,7 +1,22 @@
 set(sources ${sources}
+	src/ActorIndex.cpp
 	src/Debug.cpp
+	src/Engine.cpp
+	src/Exposure.cpp
+	src/HeightCache.cpp
 	src/Hooks.cpp
+	src/Jobs.cpp
+	src/MappedFile.cpp
 	src/PCH.cpp
+	src/Particles.cpp
+	src/RayBatch.cpp
+	src/Sampler.cpp
 	src/Settings.cpp
+	src/SettingsLoader.cpp
+	src/SpanCache.cpp
+	src/Stats.cpp
+	src/Surface.cpp
+	src/Trace.cpp
+	src/WaterIndex.cpp
 	src/main.cpp
 )
@@ -0,0 +1,183 @@
+#include "Scene.h"
+#include "Stats.h"
+#include "WaterIndex.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+	// mean havok ray length and main thread microseconds per query, over the last frames the stats tracker holds
+	void AddQueryCounters(benchmark::State& a_state)
+	{
+		const auto  report = Stats::Tracker::GetSingleton()->GetReport();
+		const auto& heavy = report.tiers[std::to_underlying(Rain::TYPE::kHeavy)];
+		a_state.counters["span"] = benchmark::Counter(heavy.GetAverageRayLength());
+		a_state.counters["us/query"] = benchmark::Counter(heavy.GetAverageQueryTime());
+	}
+
+	// one iteration = one frame of heavy rain, hooks through the drain
+	void BM_Frame(benchmark::State& a_state, Headless::Scene (*a_makeScene)(), const Headless::Driver::Options& a_options)
+	{
+		const auto scene = a_makeScene();
+
+		Headless::Driver driver(scene, a_options);
+		for (auto _ : a_state) {
+			driver.Frame();
+		}
+		driver.Finish();
+
+		const auto result = driver.GetResult();
+		a_state.counters["rays/frame"] = benchmark::Counter(static_cast<double>(result.rayCasts) / static_cast<double>(result.frames));
+		a_state.counters["spawns/frame"] = benchmark::Counter(static_cast<double>(result.spawns + result.ripples) / static_cast<double>(result.frames));
+		// share of the screen the splashes cover per havok query, higher means the rays went where they can be seen
+		a_state.counters["coverage/ray"] = benchmark::Counter(result.rayCasts > 0 ? result.coverage / static_cast<double>(result.rayCasts) : 0.0);
+		AddQueryCounters(a_state);
+	}
+
+	// one iteration = one drain of a_state.range(0) splash rays on a grid around the player, the per-ray loop on its own
+	void BM_DrainRays(benchmark::State& a_state, Headless::Scene (*a_makeScene)(), const Headless::Driver::Options& a_options)
+	{
+		const auto scene = a_makeScene();
+		const auto count = static_cast<std::int32_t>(a_state.range(0));
+		const auto side = static_cast<std::int32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+
+		std::vector<Engine::Point3> origins;
+		origins.reserve(count);
+		for (std::int32_t i = 0; i < count; i++) {
+			const auto x = static_cast<float>(i % side - side / 2) * 48.0f;
+			const auto y = static_cast<float>(i / side - side / 2) * 48.0f;
+			origins.push_back(scene.player + Engine::Point3{ x, y, 0.0f });
+		}
+
+		Headless::Driver driver(scene, a_options);
+		for (auto _ : a_state) {
+			driver.DrainRays(RayCast::Batch::TYPE::kSplash, origins);
+		}
+		driver.Finish();
+
+		a_state.SetItemsProcessed(a_state.iterations() * count);
+		AddQueryCounters(a_state);
+	}
+
+	Sampler::PointBatch MakeSampleBatch(std::size_t a_count)
+	{
+		Sampler::PointBatch batch;
+		batch.resize(a_count);
+		for (std::size_t i = 0; i < a_count; i++) {
+			batch.u[i] = static_cast<float>(std::fmod(0.5 + 0.7548776662 * static_cast<double>(i + 1), 1.0));
+			batch.v[i] = static_cast<float>(std::fmod(0.5 + 0.5698402910 * static_cast<double>(i + 1), 1.0));
+		}
+		return batch;
+	}
+
+	// one iteration = a_state.range(0) points through the polar conversion and the frustum cull, the way GenerateDiskPoints runs them
+	void BM_SampleBatch(benchmark::State& a_state, bool a_vector)
+	{
+		const auto scene = Headless::MakeFlat();
+		const auto frustum = Headless::GetFrustum(scene.camera);
+		const auto count = static_cast<std::size_t>(a_state.range(0));
+		const auto samples = MakeSampleBatch(count);
+
+		auto batch = samples;
+		for (auto _ : a_state) {
+			batch.count = count;
+			if (a_vector) {
+				Sampler::PolarToCartesian(batch, 0.0f, 0.0f, 4096.0f, 0.0f, Engine::TWO_PI);
+				Sampler::CullToFrustum(batch, 0.0f, frustum, 32.0f);
+			} else {
+				Sampler::Scalar::PolarToCartesian(batch, 0.0f, 0.0f, 4096.0f, 0.0f, Engine::TWO_PI);
+				Sampler::Scalar::CullToFrustum(batch, 0.0f, frustum, 32.0f);
+			}
+			benchmark::DoNotOptimize(batch.x.data());
+			benchmark::ClobberMemory();
+		}
+
+		a_state.SetItemsProcessed(a_state.iterations() * static_cast<std::int64_t>(count));
+	}
+
+	// a_side x a_side points spread over the marsh, about a third of them in a pool
+	std::vector<Engine::Point3> GetWaterQueries(std::int32_t a_side)
+	{
+		std::vector<Engine::Point3> queries;
+		queries.reserve(static_cast<std::size_t>(a_side) * a_side);
+		for (std::int32_t y = 0; y < a_side; y++) {
+			for (std::int32_t x = 0; x < a_side; x++) {
+				queries.push_back({ (static_cast<float>(x) / a_side - 0.5f) * 8192.0f, (static_cast<float>(y) / a_side - 0.5f) * 8192.0f, 0.0f });
+			}
+		}
+		return queries;
+	}
+
+	// what point_in_water did per ray before the index, every flat bound in order
+	std::optional<float> ScanWaterHeight(const Headless::Scene& a_scene, float a_x, float a_y)
+	{
+		for (const auto& [center, size] : a_scene.water) {
+			if (size.z <= 10.0f) {
+				if (!(a_x < center.x - size.x || a_x > center.x + size.x || a_y < center.y - size.y || a_y > center.y + size.y)) {
+					return center.z;
+				}
+			}
+		}
+		return std::nullopt;
+	}
+
+	// one iteration = 1024 water height queries against a_state.range(0) pools, behind the change check every drain makes first
+	void BM_WaterHeight(benchmark::State& a_state, bool a_index)
+	{
+		const auto scene = Headless::MakeMarsh(static_cast<std::uint32_t>(a_state.range(0)));
+		const auto queries = GetWaterQueries(32);
+
+		Headless::WaterSystem waterSystem(scene);
+		const auto            index = Water::Index::GetSingleton();
+
+		for (auto _ : a_state) {
+			if (a_index) {
+				index->Update(&waterSystem);
+			}
+			for (const auto& query : queries) {
+				benchmark::DoNotOptimize(a_index ? index->GetWaterHeight(query.x, query.y) : ScanWaterHeight(scene, query.x, query.y));
+			}
+		}
+
+		a_state.SetItemsProcessed(a_state.iterations() * static_cast<std::int64_t>(queries.size()));
+	}
+
+	Headless::Scene MakeFlat() { return Headless::MakeFlat(); }
+	Headless::Scene MakeCity() { return Headless::MakeCity(); }
+	Headless::Scene MakeMarsh() { return Headless::MakeMarsh(); }
+	Headless::Scene MakeCrowd() { return Headless::MakeCrowd(); }
+}
+
+BENCHMARK_CAPTURE(BM_Frame, Flat, MakeFlat, {});
+BENCHMARK_CAPTURE(BM_Frame, City, MakeCity, {});
+BENCHMARK_CAPTURE(BM_Frame, Marsh, MakeMarsh, {});
+BENCHMARK_CAPTURE(BM_Frame, Crowd, MakeCrowd, {});
+BENCHMARK_CAPTURE(BM_Frame, FlatAsync, MakeFlat, { .asyncRaycasts = true });
+BENCHMARK_CAPTURE(BM_Frame, CityAsync, MakeCity, { .asyncRaycasts = true });
+BENCHMARK_CAPTURE(BM_Frame, MarshAsync, MakeMarsh, { .asyncRaycasts = true });
+BENCHMARK_CAPTURE(BM_Frame, CrowdAsync, MakeCrowd, { .asyncRaycasts = true });
+BENCHMARK_CAPTURE(BM_Frame, FlatPerRayTasks, MakeFlat, { .batchRays = false });
+BENCHMARK_CAPTURE(BM_Frame, CityPerRayTasks, MakeCity, { .batchRays = false });
+// without the height cache every splash costs a ray, so coverage/ray compares the sampling alone
+BENCHMARK_CAPTURE(BM_Frame, FlatUniform, MakeFlat, { .heightCache = false });
+BENCHMARK_CAPTURE(BM_Frame, CityUniform, MakeCity, { .heightCache = false });
+BENCHMARK_CAPTURE(BM_Frame, FlatFalloff, MakeFlat, { .samplingFalloff = 1.0f, .heightCache = false });
+BENCHMARK_CAPTURE(BM_Frame, CityFalloff, MakeCity, { .samplingFalloff = 1.0f, .heightCache = false });
+// the uniform captures above use RaySpanMode 2
+BENCHMARK_CAPTURE(BM_Frame, FlatFullSpan, MakeFlat, { .raySpan = Settings::RAY_SPAN::kFull, .heightCache = false });
+BENCHMARK_CAPTURE(BM_Frame, CityFullSpan, MakeCity, { .raySpan = Settings::RAY_SPAN::kFull, .heightCache = false });
+
+BENCHMARK_CAPTURE(BM_DrainRays, Flat, MakeFlat, { .heightCache = false })->Arg(64)->Arg(1024);
+BENCHMARK_CAPTURE(BM_DrainRays, City, MakeCity, { .heightCache = false })->Arg(64)->Arg(1024);
+BENCHMARK_CAPTURE(BM_DrainRays, CityHeightCache, MakeCity, { .heightCache = true })->Arg(64)->Arg(1024);
+// RaySpanMode 0 against the default 2, span and us/query are the counters to compare
+BENCHMARK_CAPTURE(BM_DrainRays, FlatFullSpan, MakeFlat, { .raySpan = Settings::RAY_SPAN::kFull, .heightCache = false })->Arg(64)->Arg(1024);
+BENCHMARK_CAPTURE(BM_DrainRays, CityFullSpan, MakeCity, { .raySpan = Settings::RAY_SPAN::kFull, .heightCache = false })->Arg(64)->Arg(1024);
+
+BENCHMARK_CAPTURE(BM_SampleBatch, Scalar, false)->RangeMultiplier(2)->Range(8, 1024);
+BENCHMARK_CAPTURE(BM_SampleBatch, Vector, true)->RangeMultiplier(2)->Range(8, 1024);
+
+BENCHMARK_CAPTURE(BM_WaterHeight, Scan, false)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_CAPTURE(BM_WaterHeight, Index, true)->Arg(10)->Arg(100)->Arg(1000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,72 @@
+#pragma once
+
+// stands in for src/PCH.h: the standard library and logging the core expects, without CommonLib or SKSE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <numeric>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace logger
+{
+	using namespace spdlog;
+
+	inline std::optional<std::filesystem::path> log_directory()
+	{
+		return std::filesystem::temp_directory_path();
+	}
+}
+
+// same shape as clib_util::singleton
+template <class T>
+class ISingleton
+{
+public:
+	static T* GetSingleton()
+	{
+		static T singleton;
+		return std::addressof(singleton);
+	}
+
+protected:
+	ISingleton() = default;
+	~ISingleton() = default;
+
+	ISingleton(const ISingleton&) = delete;
+	ISingleton(ISingleton&&) = delete;
+	ISingleton& operator=(const ISingleton&) = delete;
+	ISingleton& operator=(ISingleton&&) = delete;
+};
+
+using namespace std::literals;
+
+#include "Version.h"
@@ -0,0 +1,514 @@
+#include "Scene.h"
+
+#include "ActorIndex.h"
+#include "HeightCache.h"
+#include "Jobs.h"
+#include "RNG.h"
+#include "Scheduler.h"
+#include "Settings.h"
+#include "SpanCache.h"
+#include "Stats.h"
+#include "Surface.h"
+#include "Trace.h"
+#include "Util.h"
+
+namespace Engine
+{
+	// nothing loaded until a driver swaps its scene in
+	Interfaces& Get()
+	{
+		static Headless::Scene           empty;
+		static Headless::RayCaster       rayCaster{ empty };
+		static Headless::WaterSystem     waterSystem{ empty };
+		static Headless::Camera          camera{ empty };
+		static Headless::ParticleSpawner particles{ camera };
+		static Headless::TaskQueue       tasks;
+		static Headless::ActorSource     actors{ empty };
+
+		static Interfaces interfaces{ &rayCaster, &waterSystem, &camera, &particles, &tasks, &actors };
+		return interfaces;
+	}
+}
+
+namespace Headless
+{
+	namespace detail
+	{
+		// deterministic per index, so scenes are identical on every run
+		float Hash(std::uint32_t a_index, std::uint32_t a_salt)
+		{
+			auto x = a_index * 0x9E3779B1u ^ a_salt * 0x85EBCA77u;
+			x ^= x >> 16;
+			x *= 0x7FEB352Du;
+			x ^= x >> 15;
+			x *= 0x846CA68Bu;
+			x ^= x >> 16;
+			return static_cast<float>(x >> 8) * 0x1.0p-24f;
+		}
+
+		// camera a little behind and above the player, looking along +y
+		Engine::CameraState GetCamera(const Engine::Point3& a_player)
+		{
+			return { { a_player.x, a_player.y - 256.0f, a_player.z + 160.0f }, { 0.0f, 1.0f, 0.0f }, 80.0f };
+		}
+
+		Engine::Point3 Cross(const Engine::Point3& a_lhs, const Engine::Point3& a_rhs)
+		{
+			return { a_lhs.y * a_rhs.z - a_lhs.z * a_rhs.y, a_lhs.z * a_rhs.x - a_lhs.x * a_rhs.z, a_lhs.x * a_rhs.y - a_lhs.y * a_rhs.x };
+		}
+
+		Engine::Point3 Normalize(const Engine::Point3& a_point)
+		{
+			const auto length = std::sqrt(a_point.Dot(a_point));
+			return length > 0.0f ? a_point * (1.0f / length) : a_point;
+		}
+
+		// slab test, fraction along the segment where it enters the box
+		std::optional<float> Intersect(const Box& a_box, const Engine::Point3& a_from, const Engine::Point3& a_dir)
+		{
+			float tMin = 0.0f;
+			float tMax = 1.0f;
+
+			const std::array from{ a_from.x, a_from.y, a_from.z };
+			const std::array dir{ a_dir.x, a_dir.y, a_dir.z };
+			const std::array min{ a_box.min.x, a_box.min.y, a_box.min.z };
+			const std::array max{ a_box.max.x, a_box.max.y, a_box.max.z };
+
+			for (std::size_t i = 0; i < 3; i++) {
+				if (std::abs(dir[i]) < 1e-6f) {
+					if (from[i] < min[i] || from[i] > max[i]) {
+						return std::nullopt;
+					}
+					continue;
+				}
+
+				const float inv = 1.0f / dir[i];
+				float       t0 = (min[i] - from[i]) * inv;
+				float       t1 = (max[i] - from[i]) * inv;
+				if (t0 > t1) {
+					std::swap(t0, t1);
+				}
+
+				tMin = std::max(tMin, t0);
+				tMax = std::min(tMax, t1);
+				if (tMin > tMax) {
+					return std::nullopt;
+				}
+			}
+
+			return tMin;
+		}
+	}
+
+	Scene MakeFlat()
+	{
+		Scene scene;
+		scene.name = "Flat";
+		scene.camera = detail::GetCamera(scene.player);
+		return scene;
+	}
+
+	Scene MakeCity(std::uint32_t a_blocks)
+	{
+		constexpr float spacing = 1000.0f;
+		constexpr float footprint = 600.0f;
+
+		constexpr std::array materials{ Surface::MATERIAL::kStone, Surface::MATERIAL::kWood, Surface::MATERIAL::kMetalSolid, Surface::MATERIAL::kStoneHeavy };
+
+		Scene scene;
+		scene.name = "City";
+
+		// streets run along the multiples of spacing, the player stands on a crossing
+		const auto half = static_cast<float>(a_blocks) * 0.5f;
+		for (std::uint32_t y = 0; y < a_blocks; y++) {
+			for (std::uint32_t x = 0; x < a_blocks; x++) {
+				const auto index = y * a_blocks + x;
+				const auto centerX = (static_cast<float>(x) - half + 0.5f) * spacing;
+				const auto centerY = (static_cast<float>(y) - half + 0.5f) * spacing;
+				const auto height = 300.0f + 1200.0f * detail::Hash(index, 1);
+
+				scene.boxes.push_back({ { centerX - footprint * 0.5f, centerY - footprint * 0.5f, 0.0f },
+					{ centerX + footprint * 0.5f, centerY + footprint * 0.5f, height },
+					Engine::HIT::kStatic,
+					materials[index % materials.size()] });
+			}
+		}
+
+		scene.camera = detail::GetCamera(scene.player);
+		return scene;
+	}
+
+	Scene MakeMarsh(std::uint32_t a_pools)
+	{
+		constexpr float extent = 4096.0f;
+
+		Scene scene;
+		scene.name = "Marsh";
+
+		for (std::uint32_t i = 0; i < a_pools; i++) {
+			const Engine::Point3 center{ (detail::Hash(i, 2) - 0.5f) * extent * 2.0f, (detail::Hash(i, 3) - 0.5f) * extent * 2.0f, 16.0f };
+			const auto           radius = 64.0f + 192.0f * detail::Hash(i, 4);
+
+			scene.water.push_back({ center, { radius, radius, 0.0f } });
+
+			// a reed bed on every other pool's bank
+			if (i % 2 == 0) {
+				scene.boxes.push_back({ { center.x + radius, center.y - 32.0f, 0.0f }, { center.x + radius + 64.0f, center.y + 32.0f, 96.0f }, Engine::HIT::kStatic, Surface::MATERIAL::kGrass });
+			}
+		}
+
+		scene.camera = detail::GetCamera(scene.player);
+		return scene;
+	}
+
+	Scene MakeCrowd(std::uint32_t a_actors)
+	{
+		constexpr float ring = 384.0f;
+
+		Scene scene;
+		scene.name = "Crowd";
+
+		for (std::uint32_t i = 0; i < a_actors; i++) {
+			const auto angle = Engine::TWO_PI * static_cast<float>(i) / static_cast<float>(std::max(a_actors, 1u));
+			const auto distance = ring * (0.5f + detail::Hash(i, 5));
+
+			const Engine::ActorBound bound{ { distance * std::cos(angle), distance * std::sin(angle), 0.0f }, 32.0f, 128.0f };
+			scene.actors.push_back(bound);
+			scene.boxes.push_back({ { bound.position.x - bound.radius, bound.position.y - bound.radius, 0.0f },
+				{ bound.position.x + bound.radius, bound.position.y + bound.radius, bound.height },
+				Engine::HIT::kActor });
+		}
+
+		scene.camera = detail::GetCamera(scene.player);
+		return scene;
+	}
+
+	Sampler::FrustumPlanes GetFrustum(const Engine::CameraState& a_camera, float a_near, float a_far)
+	{
+		constexpr float aspect = 16.0f / 9.0f;
+
+		const auto forward = detail::Normalize(a_camera.forward);
+		const auto right = detail::Normalize(detail::Cross(forward, { 0.0f, 0.0f, 1.0f }));
+		const auto up = detail::Cross(right, forward);
+
+		const auto horizontal = Engine::DegToRad(a_camera.fov) * 0.5f;
+		const auto vertical = std::atan(std::tan(horizontal) / aspect);
+
+		const auto plane = [&](const Engine::Point3& a_normal, float a_offset = 0.0f) {
+			return std::array<float, 4>{ a_normal.x, a_normal.y, a_normal.z, -a_normal.Dot(a_camera.position) + a_offset };
+		};
+
+		Sampler::FrustumPlanes frustum;
+		frustum.planes = {
+			plane(forward * std::sin(horizontal) + right * std::cos(horizontal)),  // left
+			plane(forward * std::sin(horizontal) - right * std::cos(horizontal)),  // right
+			plane(forward * std::sin(vertical) + up * std::cos(vertical)),         // bottom
+			plane(forward * std::sin(vertical) - up * std::cos(vertical)),         // top
+			plane(forward, -a_near),                                               // near
+			plane(forward * -1.0f, a_far)                                          // far
+		};
+		return frustum;
+	}
+
+	RayCaster::RayCaster(const Scene& a_scene) :
+		scene(a_scene),
+		range{ a_scene.ground, a_scene.ground }
+	{
+		for (const auto& box : scene.boxes) {
+			range.min = std::min(range.min, box.min.z);
+			range.max = std::max(range.max, box.max.z);
+		}
+	}
+
+	std::optional<Engine::RayHit> RayCaster::CastRay(Engine::Cell* a_cell, const Engine::Point3& a_from, const Engine::Point3& a_to)
+	{
+		if (!GetWorld(a_cell)) {
+			rayCasts.fetch_add(1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+		return Pick(a_from, a_to);
+	}
+
+	Engine::WorldRef RayCaster::AcquireWorld(Engine::Cell* a_cell)
+	{
+		if (!GetWorld(a_cell)) {
+			return nullptr;
+		}
+		return { Engine::WorldRef{}, this };
+	}
+
+	std::optional<Engine::RayHit> RayCaster::CastRay(const Engine::WorldRef& a_world, const Engine::Point3& a_from, const Engine::Point3& a_to)
+	{
+		if (!a_world) {
+			rayCasts.fetch_add(1, std::memory_order_relaxed);
+			return std::nullopt;
+		}
+		return Pick(a_from, a_to);
+	}
+
+	std::optional<Engine::RayHit> RayCaster::Pick(const Engine::Point3& a_from, const Engine::Point3& a_to)
+	{
+		rayCasts.fetch_add(1, std::memory_order_relaxed);
+
+		const auto dir = a_to - a_from;
+
+		std::optional<Engine::RayHit> hit;
+		std::size_t                   collidable{ 0 };
+		const auto                    keep = [&](float a_fraction, Engine::HIT a_type, std::size_t a_collidable) {
+			if (!hit || a_fraction < hit->fraction) {
+				hit = Engine::RayHit{ a_from + dir * a_fraction, a_fraction, a_type, 0 };
+				collidable = a_collidable;
+			}
+		};
+
+		// ground plane, only from above
+		if (a_from.z >= scene.ground && a_to.z < scene.ground) {
+			keep((a_from.z - scene.ground) / (a_from.z - a_to.z), Engine::HIT::kStatic, 0);
+		}
+
+		for (std::size_t i = 0; i < scene.boxes.size(); i++) {
+			if (const auto fraction = detail::Intersect(scene.boxes[i], a_from, dir)) {
+				keep(*fraction, scene.boxes[i].type, i + 1);
+			}
+		}
+
+		if (hit) {
+			rayHits.fetch_add(1, std::memory_order_relaxed);
+			// same path as the game, only the nearest hit reads its material
+			if (collidable > 0) {
+				hit->material = Surface::Cache::GetSingleton()->Resolve(this, { collidable, 0, 0 }, [&] {
+					return std::to_underlying(scene.boxes[collidable - 1].material);
+				});
+			}
+		}
+		return hit;
+	}
+
+	std::optional<Engine::HeightRange> RayCaster::GetHeightRange(Engine::Cell* a_cell) const
+	{
+		if (!a_cell) {
+			return std::nullopt;
+		}
+		return range;
+	}
+
+	WaterSystem::WaterSystem(const Scene& a_scene) :
+		scene(a_scene)
+	{
+		static std::size_t instances = 0;
+		signature = ++instances;
+	}
+
+	void WaterSystem::ForEachBound(const BoundVisitor& a_visitor) const
+	{
+		for (const auto& [center, size] : scene.water) {
+			a_visitor(center, size);
+		}
+	}
+
+	void ParticleSpawner::Spawn(Engine::Cell*, const char*, float, const Engine::Point3& a_position, float a_scale)
+	{
+		spawns++;
+		if (const auto state = camera.GetState()) {
+			coverage += Stats::GetScreenCoverage(*state, a_position, a_scale);
+		}
+	}
+
+	void TaskQueue::AddTask(std::function<void()> a_task)
+	{
+		std::scoped_lock locker(lock);
+		tasks.push_back(std::move(a_task));
+	}
+
+	void TaskQueue::Run()
+	{
+		// tasks may queue more tasks
+		std::vector<std::function<void()>> running;
+		for (;;) {
+			{
+				std::scoped_lock locker(lock);
+				if (tasks.empty()) {
+					return;
+				}
+				running.swap(tasks);
+			}
+			for (auto& task : running) {
+				std::invoke(task);
+			}
+			running.clear();
+		}
+	}
+
+	std::optional<Engine::ActorBound> ActorSource::GetBound(Handle a_handle) const
+	{
+		if (a_handle == player) {
+			return Engine::ActorBound{ scene.player, 32.0f, 128.0f };
+		}
+		if (a_handle > scene.actors.size()) {
+			return std::nullopt;
+		}
+		return scene.actors[a_handle - 1];
+	}
+
+	Driver::Driver(const Scene& a_scene, const Options& a_options) :
+		scene(a_scene),
+		options(a_options),
+		rayCaster(a_scene),
+		waterSystem(a_scene),
+		camera(a_scene),
+		particles(camera),
+		actors(a_scene)
+	{
+		auto& interfaces = Engine::Get();
+		previous = interfaces;
+		interfaces = { &rayCaster, &waterSystem, &camera, &particles, &tasks, &actors };
+
+		// what Settings::Manager::Apply does in game, minus the particle pool, trace recorder and watcher
+		auto snapshot = std::make_shared<Settings::Snapshot>();
+		for (const auto& rain : { &snapshot->light, &snapshot->medium, &snapshot->heavy }) {
+			rain->splash.rayCastRate = options.splashRate;
+			rain->ripple.rayCastRate = options.rippleRate;
+		}
+		snapshot->Compile();
+		snapshot->seed = options.seed;
+		snapshot->asyncRaycasts = options.asyncRaycasts;
+		snapshot->asyncThreads = options.asyncThreads;
+		snapshot->actorSplashes = options.actorSplashes;
+		snapshot->frustumSampling = options.frustumSampling;
+		snapshot->samplingFalloff = options.samplingFalloff;
+		snapshot->raySpan = options.raySpan;
+		snapshot->heightCache = options.heightCache;
+		snapshot->rippleFastPath = options.rippleFastPath;
+		snapshot->sharedRays = options.sharedRays;
+		snapshot->frameBudget = options.frameBudget;
+		snapshot->exposureMaps = false;  // would write map files
+
+		RayCast::HeightCache::GetSingleton()->SetParameters(snapshot->heightCacheCellSize, snapshot->heightCacheLifetime);
+
+		const auto scheduler = RayCast::Scheduler::GetSingleton();
+		scheduler->SetParameters({ .budget = snapshot->frameBudget, .minScale = snapshot->frameBudgetMinScale, .maxScale = snapshot->frameBudgetMaxScale });
+
+		if (snapshot->asyncRaycasts) {
+			Jobs::Pool::GetSingleton()->Start(snapshot->asyncThreads);
+		} else {
+			Jobs::Pool::GetSingleton()->Stop();
+		}
+
+		Settings::Manager::GetSingleton()->Publish(std::move(snapshot));
+
+		RayCast::Batch::GetSingleton()->SetPerRayTasks(!options.batchRays);
+
+		ResetPipelineState();
+
+		// wraps the scene's ray caster, so it starts after the swap
+		if (!options.tracePath.empty()) {
+			Trace::Recorder::GetSingleton()->Start(options.tracePath, options.seed);
+		}
+	}
+
+	Driver::~Driver()
+	{
+		// nothing may be left out on the workers once the scene goes away
+		RayCast::Batch::GetSingleton()->Flush();
+		tasks.Run();
+		RayCast::Batch::GetSingleton()->SetPerRayTasks(false);
+		Jobs::Pool::GetSingleton()->Stop();
+		Trace::Recorder::GetSingleton()->Stop();
+
+		Engine::Get() = previous;
+	}
+
+	void Driver::ResetPipelineState()
+	{
+		util::RNG::Seed(options.seed);
+		Sampler::ResetSequences();
+		Splashes::emission.Reset();
+		Splashes::sharedEmission.Reset();
+		Splashes::actorEmission.Reset();
+		RayCast::pendingRippleRays = 0;
+		Ripples::Dynamic::emission.Reset();
+		Ripples::Dynamic::fastPathEmission.Reset();
+		RayCast::HeightCache::GetSingleton()->Clear();
+		RayCast::SpanCache::GetSingleton()->Clear();
+		RayCast::Scheduler::GetSingleton()->Reset();
+		RayCast::FrameClock::GetSingleton()->Set(0.0f);
+		Actors::Index::GetSingleton()->Clear();
+		Surface::Cache::GetSingleton()->Clear();
+		Surface::Cache::GetSingleton()->ResetCounters();
+		Stats::Tracker::GetSingleton()->Reset();
+	}
+
+	void Driver::Frame()
+	{
+		const auto settings = Settings::Manager::GetSingleton();
+
+		// UpdateShaderGeometry
+		Stats::Tracker::GetSingleton()->EndFrame(settings->GetRainType(), options.delta);
+		settings->AdvanceFrame();
+		RayCast::FrameClock::GetSingleton()->Advance(options.delta);
+		RayCast::Batch::GetSingleton()->Update();
+
+		const auto cell = GetCell();
+		Surface::Cache::GetSingleton()->Update(cell);
+
+		if (const auto rain = settings->GetRain(options.particleDensity)) {
+			const auto snapshot = settings->Get();
+			if (snapshot->actorSplashes || snapshot->heightCache) {
+				Actors::Index::GetSingleton()->Update(&actors, scene.player);
+			}
+
+			if (const auto recorder = Trace::Recorder::GetSingleton(); recorder->IsRecording()) {
+				recorder->RecordFrame(cell, options.particleDensity, options.delta, 0.0f, 0.0f, scene.player);
+			}
+
+			if (rain->splash.enabled) {
+				Splashes::Emit(rain, cell, scene.player, options.delta);
+				if (snapshot->actorSplashes) {
+					Splashes::EmitActors(rain, cell, scene.player, options.delta);
+				}
+			}
+
+			// ToggleWaterSplashes
+			if (rain->ripple.enabled) {
+				Ripples::Dynamic::Emit(rain, cell, scene.player, options.delta);
+			}
+		}
+
+		// the game's task queue runs once per frame
+		tasks.Run();
+
+		frames++;
+	}
+
+	void Driver::DrainRays(RayCast::Batch::TYPE a_type, const std::vector<Engine::Point3>& a_origins)
+	{
+		const auto settings = Settings::Manager::GetSingleton();
+		Stats::Tracker::GetSingleton()->EndFrame(settings->GetRainType(), options.delta);
+
+		const auto rain = settings->GetRain(options.particleDensity);
+		if (!rain) {
+			return;
+		}
+
+		const auto cell = GetCell();
+		const auto batch = RayCast::Batch::GetSingleton();
+		for (const auto& origin : a_origins) {
+			batch->Add(a_type, cell, rain, origin);
+		}
+		tasks.Run();
+	}
+
+	void Driver::Finish()
+	{
+		RayCast::Batch::GetSingleton()->Flush();
+		tasks.Run();
+
+		Stats::Tracker::GetSingleton()->EndFrame(Settings::Manager::GetSingleton()->GetRainType(), options.delta);
+		Trace::Recorder::GetSingleton()->Stop();
+	}
+
+	Driver::Result Driver::GetResult() const
+	{
+		return { frames, rayCaster.GetRayCasts(), rayCaster.GetRayHits(), particles.spawns, waterSystem.ripples, particles.coverage };
+	}
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "Engine.h"
+#include "RayBatch.h"
+#include "Surface.h"
+
+// synthetic scenes for driving the rain pipeline without the game, see Benchmarks.cpp and Tests.cpp
+namespace Headless
+{
+	struct Box
+	{
+		Engine::Point3    min{};
+		Engine::Point3    max{};
+		Engine::HIT       type{ Engine::HIT::kStatic };
+		Surface::MATERIAL material{ Surface::MATERIAL::kStone };
+	};
+
+	struct WaterBound
+	{
+		Engine::Point3 center{};
+		Engine::Point3 size{};  // half extents, flat water is under 10 units tall
+	};
+
+	struct Scene
+	{
+		std::string                     name;
+		float                           ground{ 0.0f };
+		std::vector<Box>                boxes;
+		std::vector<WaterBound>         water;
+		std::vector<Engine::ActorBound> actors;
+		Engine::Point3                  player{};
+		Engine::CameraState             camera{};
+		bool                            physics{ true };  // false leaves the cell without a physics world, nothing gets cast
+	};
+
+	// open ground, every ray lands on the ground plane
+	Scene MakeFlat();
+	// a grid of buildings around the player, most rays stop on a roof
+	Scene MakeCity(std::uint32_t a_blocks = 12);
+	// ground strewn with many small pools
+	Scene MakeMarsh(std::uint32_t a_pools = 256);
+	// actors standing in a ring around the player
+	Scene MakeCrowd(std::uint32_t a_actors = 32);
+
+	// inward facing planes of a 16:9 perspective camera
+	Sampler::FrustumPlanes GetFrustum(const Engine::CameraState& a_camera, float a_near = 5.0f, float a_far = 10000.0f);
+
+	class RayCaster final : public Engine::IRayCaster
+	{
+	public:
+		explicit RayCaster(const Scene& a_scene);
+
+		const void*                  GetWorld(Engine::Cell* a_cell) const override { return a_cell && scene.physics ? this : nullptr; }
+		std::optional<Engine::RayHit> CastRay(Engine::Cell* a_cell, const Engine::Point3& a_from, const Engine::Point3& a_to) override;
+
+		// the scene outlives the driver, so the reference doesn't own anything
+		Engine::WorldRef              AcquireWorld(Engine::Cell* a_cell) override;
+		std::optional<Engine::RayHit> CastRay(const Engine::WorldRef& a_world, const Engine::Point3& a_from, const Engine::Point3& a_to) override;
+
+		bool SupportsConcurrentQueries() const override { return true; }
+
+		std::optional<Engine::HeightRange> GetHeightRange(Engine::Cell* a_cell) const override;
+
+		[[nodiscard]] std::uint64_t GetRayCasts() const { return rayCasts.load(std::memory_order_relaxed); }
+		[[nodiscard]] std::uint64_t GetRayHits() const { return rayHits.load(std::memory_order_relaxed); }
+
+	private:
+		// materials go through the surface cache keyed by box index + 1, the ground has none
+		std::optional<Engine::RayHit> Pick(const Engine::Point3& a_from, const Engine::Point3& a_to);
+
+		const Scene&               scene;
+		Engine::HeightRange        range{};
+		std::atomic<std::uint64_t> rayCasts{ 0 };
+		std::atomic<std::uint64_t> rayHits{ 0 };
+	};
+
+	class WaterSystem final : public Engine::IWaterSystem
+	{
+	public:
+		explicit WaterSystem(const Scene& a_scene);
+
+		bool        IsEnabled() const override { return !scene.water.empty(); }
+		std::size_t GetSignature() const override { return signature; }
+		void        ForEachBound(const BoundVisitor& a_visitor) const override;
+		void        AddRipple(const Engine::Point3&, float) override { ripples++; }
+
+		std::uint64_t ripples{ 0 };
+
+	private:
+		const Scene& scene;
+		std::size_t  signature;  // unique per instance, so the water index rebuilds for every scene
+	};
+
+	class Camera final : public Engine::ICamera
+	{
+	public:
+		explicit Camera(const Scene& a_scene) :
+			scene(a_scene)
+		{}
+
+		std::optional<Engine::CameraState>    GetState() const override { return scene.camera; }
+		std::optional<Sampler::FrustumPlanes> GetFrustum() const override { return Headless::GetFrustum(scene.camera); }
+
+	private:
+		const Scene& scene;
+	};
+
+	class ParticleSpawner final : public Engine::IParticleSpawner
+	{
+	public:
+		explicit ParticleSpawner(const Camera& a_camera) :
+			camera(a_camera)
+		{}
+
+		void Spawn(Engine::Cell*, const char*, float, const Engine::Point3& a_position, float a_scale) override;
+
+		std::uint64_t spawns{ 0 };
+		double        coverage{ 0.0 };  // summed Stats::GetScreenCoverage of every spawn
+
+	private:
+		const Camera& camera;
+	};
+
+	// runs queued tasks when the driver says so, like the game does once per frame
+	class TaskQueue final : public Engine::ITaskQueue
+	{
+	public:
+		void AddTask(std::function<void()> a_task) override;
+		void Run();
+
+	private:
+		std::mutex                         lock;
+		std::vector<std::function<void()>> tasks;
+	};
+
+	// handle 0 is the player, the rest are the scene's actors by index + 1
+	class ActorSource final : public Engine::IActorSource
+	{
+	public:
+		explicit ActorSource(const Scene& a_scene) :
+			scene(a_scene)
+		{}
+
+		std::size_t                       GetHandleCount() const override { return scene.actors.size(); }
+		Handle                            GetHandle(std::size_t a_index) const override { return static_cast<Handle>(a_index + 1); }
+		std::optional<Engine::ActorBound> GetBound(Handle a_handle) const override;
+
+	private:
+		const Scene& scene;
+	};
+
+	// swaps the scene in for the game and runs frames through the same sequence as the hooks
+	class Driver
+	{
+	public:
+		// every optional stage is on unless turned off here, whatever the shipped config defaults to
+		struct Options
+		{
+			float                 particleDensity{ 12.0f };  // heavy
+			float                 delta{ 1.0f / 60.0f };
+			float                 splashRate{ 300.0f };  // rays per second, the shipped config's heavy rain
+			float                 rippleRate{ 1500.0f };
+			std::uint64_t         seed{ 1 };
+			bool                  asyncRaycasts{ false };
+			std::uint32_t         asyncThreads{ 2 };
+			bool                  batchRays{ true };
+			bool                  actorSplashes{ true };
+			bool                  frustumSampling{ true };
+			float                 samplingFalloff{ 0.0f };
+			Settings::RAY_SPAN    raySpan{ Settings::RAY_SPAN::kTwoPhase };
+			bool                  heightCache{ true };
+			bool                  rippleFastPath{ true };
+			bool                  sharedRays{ true };
+			float                 frameBudget{ 0.0f };  // milliseconds, the controller scales rays on this machine's timing
+			std::filesystem::path tracePath{};  // records the frames there, like TraceMode = 1 does in game
+		};
+
+		struct Result
+		{
+			std::uint64_t frames{ 0 };
+			std::uint64_t rayCasts{ 0 };
+			std::uint64_t rayHits{ 0 };
+			std::uint64_t spawns{ 0 };
+			std::uint64_t ripples{ 0 };
+			double        coverage{ 0.0 };
+		};
+
+		Driver(const Scene& a_scene, const Options& a_options);
+		~Driver();
+
+		Driver(const Driver&) = delete;
+		Driver& operator=(const Driver&) = delete;
+
+		void Frame();
+
+		// queues rays at a_origins in the scene's cell and runs the drain on its own, skipping sampling and the hooks
+		void DrainRays(RayCast::Batch::TYPE a_type, const std::vector<Engine::Point3>& a_origins);
+
+		// waits for queries still out on the workers and resolves them, then closes the stats tracker's frame and the trace
+		void Finish();
+
+		[[nodiscard]] Result GetResult() const;
+
+		// the scene stands in for the one loaded cell
+		[[nodiscard]] Engine::Cell* GetCell() const { return reinterpret_cast<Engine::Cell*>(const_cast<Scene*>(&scene)); }
+
+	private:
+		void ResetPipelineState();
+
+		const Scene&    scene;
+		Options         options;
+		RayCaster       rayCaster;
+		WaterSystem     waterSystem;
+		Camera          camera;
+		ParticleSpawner particles;
+		TaskQueue       tasks;
+		ActorSource     actors;
+
+		Engine::Interfaces previous;
+		std::uint64_t      frames{ 0 };
+	};
+}
@@ -0,0 +1,478 @@
+#include "Scene.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "Util.h"
+#include "WaterIndex.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+	Headless::Driver::Result RunFrames(const Headless::Scene& a_scene, const Headless::Driver::Options& a_options, std::uint32_t a_frames = 120)
+	{
+		Headless::Driver driver(a_scene, a_options);
+		for (std::uint32_t i = 0; i < a_frames; i++) {
+			driver.Frame();
+		}
+		driver.Finish();
+		return driver.GetResult();
+	}
+
+	// advanced by hand so the budget controller sees exact frame costs
+	struct SimulatedClock
+	{
+		using duration = std::chrono::microseconds;
+		using rep = duration::rep;
+		using period = duration::period;
+		using time_point = std::chrono::time_point<SimulatedClock>;
+
+		static constexpr bool is_steady = true;
+
+		static time_point now() { return current; }
+		static void       Advance(float a_ms) { current += std::chrono::duration_cast<duration>(std::chrono::duration<float, std::milli>(a_ms)); }
+
+		static inline time_point current{};
+	};
+
+	// R2 samples, spread evenly over both axes without touching the sampler's own sequence
+	Sampler::PointBatch MakeSampleBatch(std::size_t a_count)
+	{
+		Sampler::PointBatch batch;
+		batch.resize(a_count);
+		for (std::size_t i = 0; i < a_count; i++) {
+			batch.u[i] = static_cast<float>(std::fmod(0.5 + 0.7548776662 * static_cast<double>(i + 1), 1.0));
+			batch.v[i] = static_cast<float>(std::fmod(0.5 + 0.5698402910 * static_cast<double>(i + 1), 1.0));
+		}
+		return batch;
+	}
+
+	using SimulatedController = RayCast::BudgetController<SimulatedClock>;
+
+	// one drain whose main thread part takes a_drain ms and whose jobs took a_jobs ms, cost scaling with the ray count
+	void RunDrain(SimulatedController& a_controller, float a_drain, float a_jobs = 0.0f)
+	{
+		a_controller.Begin();
+		SimulatedClock::Advance(a_drain * a_controller.GetScale());
+		a_controller.AddJobCost(a_jobs * a_controller.GetScale());
+		a_controller.End();
+	}
+}
+
+TEST(Scene, FlatRaysLandOnTheGround)
+{
+	const auto scene = Headless::MakeFlat();
+	Headless::RayCaster rayCaster(scene);
+
+	int        cell = 0;
+	const auto hit = rayCaster.CastRay(reinterpret_cast<Engine::Cell*>(&cell), { 10.0f, 20.0f, 500.0f }, { 10.0f, 20.0f, -500.0f });
+	ASSERT_TRUE(hit);
+	EXPECT_FLOAT_EQ(hit->position.z, 0.0f);
+	EXPECT_FLOAT_EQ(hit->fraction, 0.5f);
+	EXPECT_EQ(hit->type, Engine::HIT::kStatic);
+}
+
+TEST(Scene, CityRaysStopOnRoofs)
+{
+	const auto scene = Headless::MakeCity(2);
+	Headless::RayCaster rayCaster(scene);
+
+	const auto& box = scene.boxes.front();
+	const auto  x = (box.min.x + box.max.x) * 0.5f;
+	const auto  y = (box.min.y + box.max.y) * 0.5f;
+
+	int        cell = 0;
+	const auto hit = rayCaster.CastRay(reinterpret_cast<Engine::Cell*>(&cell), { x, y, 5000.0f }, { x, y, -5000.0f });
+	ASSERT_TRUE(hit);
+	EXPECT_NEAR(hit->position.z, box.max.z, 0.01f);
+	EXPECT_EQ(hit->material, std::to_underlying(box.material));
+}
+
+TEST(Scene, FrustumContainsWhatTheCameraFaces)
+{
+	const auto scene = Headless::MakeFlat();
+	const auto frustum = Headless::GetFrustum(scene.camera);
+
+	EXPECT_TRUE(frustum.Contains({ 0.0f, 1000.0f, 0.0f }, 0.0f));
+	EXPECT_FALSE(frustum.Contains({ 0.0f, -2000.0f, 0.0f }, 0.0f));
+	EXPECT_FALSE(frustum.Contains({ 5000.0f, 0.0f, 0.0f }, 0.0f));
+}
+
+TEST(Sampler, VectorPathMatchesScalar)
+{
+	const auto scene = Headless::MakeFlat();
+	const auto frustum = Headless::GetFrustum(scene.camera);
+
+	// every power of two the benchmark covers, plus sizes that leave a scalar tail
+	for (const std::size_t count : { 8u, 13u, 16u, 31u, 64u, 128u, 256u, 509u, 512u, 1024u }) {
+		auto vector = MakeSampleBatch(count);
+		auto scalar = MakeSampleBatch(count);
+
+		Sampler::PolarToCartesian(vector, 100.0f, -50.0f, 4096.0f, -Engine::PI, Engine::TWO_PI);
+		Sampler::Scalar::PolarToCartesian(scalar, 100.0f, -50.0f, 4096.0f, -Engine::PI, Engine::TWO_PI);
+
+		for (std::size_t i = 0; i < count; i++) {
+			EXPECT_NEAR(vector.x[i], scalar.x[i], 0.01f) << count << " " << i;
+			EXPECT_NEAR(vector.y[i], scalar.y[i], 0.01f) << count << " " << i;
+
+			// and both stay within the approximation's error of the real thing
+			const float theta = -Engine::PI + scalar.u[i] * Engine::TWO_PI;
+			const float r = 4096.0f * std::sqrt(scalar.v[i]);
+			EXPECT_NEAR(scalar.x[i], 100.0f + r * std::cos(theta), 4096.0f * 2e-4f);
+			EXPECT_NEAR(scalar.y[i], -50.0f + r * std::sin(theta), 4096.0f * 2e-4f);
+		}
+
+		// cull the same coordinates, so the kept sets can be compared exactly
+		scalar.x = vector.x;
+		scalar.y = vector.y;
+
+		const auto kept = Sampler::CullToFrustum(vector, 0.0f, frustum, 32.0f);
+		ASSERT_EQ(kept, Sampler::Scalar::CullToFrustum(scalar, 0.0f, frustum, 32.0f)) << count;
+		for (std::size_t i = 0; i < kept; i++) {
+			EXPECT_EQ(vector.x[i], scalar.x[i]);
+			EXPECT_EQ(vector.y[i], scalar.y[i]);
+		}
+	}
+}
+
+TEST(Sampler, SectorAroundThePlayerCoversWhatTheCameraSees)
+{
+	const auto             scene = Headless::MakeFlat();
+	const auto             frustum = Headless::GetFrustum(scene.camera);
+	const Headless::Driver driver(scene, {});
+
+	// the camera sits behind the player, so a wedge from the camera would miss what it sees beside the player
+	constexpr float radius = 1024.0f;
+	const auto      sector = Sampler::GetCameraSector(scene.player, radius);
+	ASSERT_TRUE(sector);
+	EXPECT_EQ(sector->origin, scene.player);
+
+	for (float x = -radius; x <= radius; x += 32.0f) {
+		for (float y = -radius; y <= radius; y += 32.0f) {
+			const Engine::Point3 point{ scene.player.x + x, scene.player.y + y, scene.player.z };
+			if (const auto distance = std::hypot(x, y); distance < radius * 0.5f || distance > radius || !frustum.Contains(point, 0.0f)) {
+				continue;
+			}
+			const auto angle = std::remainder(std::atan2(y, x) - sector->yaw, 2.0f * Engine::PI);
+			EXPECT_LE(std::abs(angle), sector->halfAngle) << x << ", " << y;
+		}
+	}
+}
+
+TEST(Sampler, StratifiedFillsEveryStratum)
+{
+	util::RNG::Seed(7);
+
+	// counts that leave a grid's last row short included, 3 and 5 are the medium and heavy tiers at 60 fps
+	for (std::uint32_t count = 1; count <= 17; count++) {
+		Sampler::PointBatch batch;
+		Sampler::GenerateSamples(batch, count, Sampler::PATTERN::kStratified, util::RNG::STREAM::kSplash);
+
+		std::vector<std::uint32_t> angles(count);
+		std::vector<std::uint32_t> radii(count);
+		for (std::size_t i = 0; i < count; i++) {
+			angles[std::min(static_cast<std::uint32_t>(batch.u[i] * static_cast<float>(count)), count - 1)]++;
+			radii[std::min(static_cast<std::uint32_t>(batch.v[i] * static_cast<float>(count)), count - 1)]++;
+		}
+
+		EXPECT_TRUE(std::ranges::all_of(angles, [](auto a_samples) { return a_samples == 1; })) << count;
+		EXPECT_TRUE(std::ranges::all_of(radii, [](auto a_samples) { return a_samples == 1; })) << count;
+	}
+}
+
+TEST(Surface, SubShapesOfOneCollidableKeepTheirMaterial)
+{
+	auto& cache = *Surface::Cache::GetSingleton();
+	cache.Clear();
+	cache.ResetCounters();
+
+	int        world = 0;
+	int        resolves = 0;
+	const auto resolve = [&](Surface::MATERIAL a_material) {
+		return [&resolves, a_material] {
+			resolves++;
+			return std::to_underlying(a_material);
+		};
+	};
+
+	const Surface::Cache::Key stone{ 0x1000, 0x100, 1 };
+	const Surface::Cache::Key wood{ 0x1000, 0x100, 2 };
+
+	EXPECT_EQ(cache.Resolve(&world, stone, resolve(Surface::MATERIAL::kStone)), std::to_underlying(Surface::MATERIAL::kStone));
+	EXPECT_EQ(cache.Resolve(&world, wood, resolve(Surface::MATERIAL::kWood)), std::to_underlying(Surface::MATERIAL::kWood));
+	EXPECT_EQ(cache.Resolve(&world, stone, resolve(Surface::MATERIAL::kWood)), std::to_underlying(Surface::MATERIAL::kStone));
+	EXPECT_EQ(resolves, 2);
+	EXPECT_FLOAT_EQ(cache.GetHitRate(), 1.0f / 3.0f);
+
+	cache.Clear();
+}
+
+TEST(Surface, ReusedCollidableAddressIsReclassified)
+{
+	auto& cache = *Surface::Cache::GetSingleton();
+	cache.Clear();
+
+	int                       world = 0;
+	const Surface::Cache::Key before{ 0x2000, 0x100, 0 };
+	const Surface::Cache::Key after{ 0x2000, 0x200, 0 };  // freed and reallocated with another shape
+
+	const auto stone = [] { return std::to_underlying(Surface::MATERIAL::kStone); };
+	const auto grass = [] { return std::to_underlying(Surface::MATERIAL::kGrass); };
+
+	EXPECT_EQ(Surface::GetType(cache.Resolve(&world, before, stone)), Surface::TYPE::kStone);
+	EXPECT_EQ(Surface::GetType(cache.Resolve(&world, after, grass)), Surface::TYPE::kFoliage);
+
+	cache.Clear();
+}
+
+TEST(Surface, CellChangeFlushesTheCache)
+{
+	auto& cache = *Surface::Cache::GetSingleton();
+	cache.Clear();
+
+	int                       world = 0;
+	int                       cells[2]{};
+	int                       resolves = 0;
+	const Surface::Cache::Key key{ 0x3000, 0x100, 0 };
+	const auto                stone = [&] {
+		resolves++;
+		return std::to_underlying(Surface::MATERIAL::kStone);
+	};
+
+	cache.Update(&cells[0]);
+	cache.Resolve(&world, key, stone);
+	cache.Update(&cells[0]);
+	cache.Resolve(&world, key, stone);
+	EXPECT_EQ(resolves, 1);
+
+	cache.Update(&cells[1]);
+	cache.Resolve(&world, key, stone);
+	EXPECT_EQ(resolves, 2);
+
+	cache.Update(nullptr);
+	cache.Clear();
+	Stats::Tracker::GetSingleton()->Reset();
+}
+
+TEST(Water, IndexMatchesLinearScan)
+{
+	auto scene = Headless::MakeMarsh(1000);
+	scene.water.push_back({ { 0.0f, 0.0f, 512.0f }, { 4096.0f, 4096.0f, 256.0f } });  // sloped, never counted
+
+	Headless::WaterSystem waterSystem(scene);
+	const auto            index = Water::Index::GetSingleton();
+	index->Update(&waterSystem);
+
+	for (float y = -4096.0f; y <= 4096.0f; y += 37.0f) {
+		for (float x = -4096.0f; x <= 4096.0f; x += 37.0f) {
+			std::optional<float> expected;
+			for (const auto& [center, size] : scene.water) {
+				if (size.z <= 10.0f && !(x < center.x - size.x || x > center.x + size.x || y < center.y - size.y || y > center.y + size.y)) {
+					expected = center.z;
+					break;
+				}
+			}
+			ASSERT_EQ(index->GetWaterHeight(x, y), expected) << x << ", " << y;
+		}
+	}
+}
+
+TEST(HeightCache, HitsNextToActorsAreCastAgain)
+{
+	const auto                  scene = Headless::MakeCrowd(1);
+	const Headless::ActorSource actors(scene);
+	const auto                  actorIndex = Actors::Index::GetSingleton();
+	const auto                  heightCache = RayCast::HeightCache::GetSingleton();
+
+	const RayCast::RayOptions<true, false> options;
+
+	actorIndex->Update(&actors, scene.player);
+	heightCache->Clear();
+
+	const auto actor = scene.actors[0].position;
+	const auto open = Engine::Point3{ -1024.0f, 0.0f, 0.0f };
+	heightCache->Store(&scene, actor, 0.0f, Surface::TYPE::kDefault, false);
+	heightCache->Store(&scene, open, 0.0f, Surface::TYPE::kDefault, false);
+
+	EXPECT_FALSE(RayCast::LookupRayCast(options, &scene, { actor }));
+	EXPECT_TRUE(RayCast::LookupRayCast(options, &scene, { open }));
+
+	heightCache->Clear();
+	actorIndex->Clear();
+}
+
+TEST(HeightCache, OnlyStaticHitsAreCached)
+{
+	const auto scene = Headless::MakeFlat();
+	const auto heightCache = RayCast::HeightCache::GetSingleton();
+
+	const RayCast::RayOptions<true, false> options;
+
+	heightCache->Clear();
+
+	const auto clutter = Engine::Point3{ 0.0f, 0.0f, 0.0f };
+	const auto ground = Engine::Point3{ 1024.0f, 0.0f, 0.0f };
+	RayCast::ResolveRayCast(options, &scene, { clutter }, Engine::RayHit{ .position = clutter, .type = Engine::HIT::kDynamic });
+	RayCast::ResolveRayCast(options, &scene, { ground }, Engine::RayHit{ .position = ground, .type = Engine::HIT::kStatic });
+
+	EXPECT_FALSE(RayCast::LookupRayCast(options, &scene, { clutter }));
+	EXPECT_TRUE(RayCast::LookupRayCast(options, &scene, { ground }));
+
+	heightCache->Clear();
+}
+
+TEST(Settings, DensityBelowATierBoundaryKeepsItsTier)
+{
+	const Settings::Snapshot snapshot;
+
+	EXPECT_EQ(snapshot.GetRain(4.96f)->type, Rain::TYPE::kLight);
+	EXPECT_EQ(snapshot.GetRain(5.0f)->type, Rain::TYPE::kMedium);
+	EXPECT_EQ(snapshot.GetRain(8.99f)->type, Rain::TYPE::kMedium);
+	EXPECT_EQ(snapshot.GetRain(9.0f)->type, Rain::TYPE::kHeavy);
+	EXPECT_EQ(snapshot.GetRain(100.0f)->type, Rain::TYPE::kHeavy);
+}
+
+TEST(Settings, CompiledTableFollowsCurves)
+{
+	const Settings::DensityCurve curve({ { 1.0f, 120.0f }, { 7.0f, 180.0f }, { 12.0f, 300.0f } });
+
+	Settings::Snapshot::CurveOverrides overrides{};
+	overrides[std::to_underlying(Settings::Snapshot::CURVE::kSplashRate)] = curve;
+
+	Settings::Snapshot snapshot;
+	snapshot.Compile(overrides);
+
+	// the steepest segment climbs 24 rays per second per unit of density, the table may lag it by one step
+	constexpr float tolerance = 1.0f;
+	for (float density = 0.0f; density <= 20.0f; density += 0.013f) {
+		EXPECT_NEAR(snapshot.GetRain(density)->splash.rayCastRate, curve.Evaluate(density), tolerance) << density;
+	}
+}
+
+TEST(Budget, ScaleSettlesOnTheBudget)
+{
+	SimulatedController controller;
+	controller.SetParameters({ .budget = 1.0f });
+
+	for (int i = 0; i < 200; i++) {
+		RunDrain(controller, 2.0f);
+	}
+
+	EXPECT_NEAR(controller.GetScale(), 0.5f, 0.05f);
+	EXPECT_NEAR(controller.GetAverageCost(), 1.0f, 0.1f);
+}
+
+TEST(Budget, JobTimeCountsAgainstTheBudget)
+{
+	SimulatedController controller;
+	controller.SetParameters({ .budget = 1.0f });
+
+	// the main thread only collects, the workers do the casting
+	for (int i = 0; i < 200; i++) {
+		RunDrain(controller, 0.1f, 1.9f);
+	}
+
+	EXPECT_NEAR(controller.GetScale(), 0.5f, 0.05f);
+}
+
+TEST(Budget, FreeFramesStepUpByTheGain)
+{
+	SimulatedController controller;
+	controller.SetParameters({ .budget = 1.0f, .gain = 0.25f });
+
+	RunDrain(controller, 0.0f);
+	EXPECT_FLOAT_EQ(controller.GetScale(), 1.25f);
+
+	for (int i = 0; i < 100; i++) {
+		RunDrain(controller, 0.0f);
+	}
+	EXPECT_FLOAT_EQ(controller.GetScale(), 4.0f);
+
+	// a costly frame after the free ones pulls the scale back down
+	RunDrain(controller, 100.0f);
+	EXPECT_LT(controller.GetScale(), 4.0f);
+	EXPECT_GE(controller.GetScale(), 0.25f);
+}
+
+TEST(Pipeline, FlatSpawnsSplashes)
+{
+	const auto result = RunFrames(Headless::MakeFlat(), {});
+
+	EXPECT_EQ(result.frames, 120u);
+	EXPECT_GT(result.spawns, 0u);
+	EXPECT_EQ(result.ripples, 0u);
+}
+
+TEST(Pipeline, MarshSpawnsRipples)
+{
+	const auto result = RunFrames(Headless::MakeMarsh(), {});
+
+	EXPECT_GT(result.ripples, 0u);
+}
+
+TEST(Pipeline, CrowdSplashesActors)
+{
+	const auto result = RunFrames(Headless::MakeCrowd(), {});
+
+	EXPECT_GT(result.spawns, 0u);
+}
+
+TEST(Pipeline, SameSeedSameFrames)
+{
+	const auto scene = Headless::MakeCity();
+
+	const auto first = RunFrames(scene, { .seed = 42 });
+	const auto second = RunFrames(scene, { .seed = 42 });
+
+	EXPECT_EQ(first.rayCasts, second.rayCasts);
+	EXPECT_EQ(first.rayHits, second.rayHits);
+	EXPECT_EQ(first.spawns, second.spawns);
+	EXPECT_EQ(first.ripples, second.ripples);
+}
+
+TEST(Pipeline, AsyncMatchesSync)
+{
+	// a marsh without a physics world still gets its unsheltered ripples, on either path
+	auto noPhysics = Headless::MakeMarsh();
+	noPhysics.physics = false;
+
+	// ripple and actor probes too, not only splash rays
+	for (const auto& scene : { Headless::MakeFlat(), Headless::MakeMarsh(), Headless::MakeCrowd(), noPhysics }) {
+		const auto sync = RunFrames(scene, { .heightCache = false });
+		const auto async = RunFrames(scene, { .asyncRaycasts = true, .heightCache = false });
+
+		EXPECT_GT(async.spawns + async.ripples, 0u) << scene.name;
+		EXPECT_EQ(sync.rayCasts, async.rayCasts) << scene.name;
+		EXPECT_EQ(sync.spawns, async.spawns) << scene.name;
+		EXPECT_EQ(sync.ripples, async.ripples) << scene.name;
+	}
+}
+
+TEST(Trace, ReplayReproducesTheRecordedFrames)
+{
+	// the ground sits below the full span, so rays that miss the reeds cast the tight span and then the full one
+	// a jetty next to the player gives the splashes something to land on whatever the budget scale drops to
+	auto scene = Headless::MakeMarsh();
+	scene.ground = -12000.0f;
+	scene.boxes.push_back({ { -512.0f, -512.0f, 0.0f }, { 0.0f, 512.0f, 32.0f } });
+	const auto path = std::filesystem::temp_directory_path() / "headless_replay.trace";
+
+	// trace mode turns actor splashes off in game; a budget small enough to keep the scale moving with this machine's timing
+	Headless::Driver driver(scene, { .seed = 7, .actorSplashes = false, .frameBudget = 0.01f, .tracePath = path });
+	for (std::uint32_t i = 0; i < 120; i++) {
+		driver.Frame();
+	}
+	driver.Finish();
+	const auto recorded = driver.GetResult();
+
+	const auto replayed = Trace::Replay(path);
+	std::filesystem::remove(path);
+
+	ASSERT_TRUE(replayed);
+	EXPECT_GT(recorded.spawns, 0u);
+	EXPECT_GT(recorded.ripples, 0u);
+	EXPECT_EQ(replayed->frames, recorded.frames);
+	EXPECT_EQ(replayed->rayCasts, recorded.rayCasts);
+	EXPECT_EQ(replayed->rayHits, recorded.rayHits);
+	EXPECT_EQ(replayed->spawns, recorded.spawns);
+	EXPECT_EQ(replayed->ripples, recorded.ripples);
+}
@@ -0,0 +1,190 @@
+#include "ActorIndex.h"
+
+namespace Actors
+{
+	Index::Index()
+	{
+		buckets.fill(-1);
+	}
+
+	std::int32_t Index::GetBucketCoord(float a_pos)
+	{
+		return static_cast<std::int32_t>(std::floor(a_pos / bucketSize));
+	}
+
+	std::size_t Index::Hash(std::int32_t a_x, std::int32_t a_y)
+	{
+		return (static_cast<std::size_t>(a_x) * 73856093 ^ static_cast<std::size_t>(a_y) * 19349663) & (bucketCount - 1);
+	}
+
+	bool Index::GetBound(const Engine::IActorSource* a_source, Engine::IActorSource::Handle a_handle, Bound& a_bound)
+	{
+		const auto bound = a_source->GetBound(a_handle);
+		if (!bound) {
+			return false;
+		}
+
+		a_bound.handle = a_handle;
+		a_bound.position = bound->position;
+		a_bound.radius = std::min(bound->radius, maxRadius);
+		a_bound.height = bound->height;
+
+		return a_bound.radius > 0.0f && a_bound.height > 0.0f;
+	}
+
+	void Index::Update(const Engine::IActorSource* a_source, const Engine::Point3& a_playerPos)
+	{
+		const auto isTracked = [&](const Bound& a_bound) {
+			const auto dx = a_bound.position.x - a_playerPos.x;
+			const auto dy = a_bound.position.y - a_playerPos.y;
+			return dx * dx + dy * dy < trackRadius * trackRadius;
+		};
+
+		// the player isn't in the process lists, it always sits in the first entry and is refreshed every frame
+		if (entries.empty()) {
+			entries.emplace_back();
+		}
+		if (!GetBound(a_source, Engine::IActorSource::player, entries.front().bound)) {
+			entries.front().bound = {};
+		}
+
+		// refresh a slice of the others, dropping the ones that unloaded, died or wandered off
+		for (std::size_t i = 0; i < refreshCount && entries.size() > 1; i++) {
+			if (refreshCursor == 0 || refreshCursor >= entries.size()) {
+				refreshCursor = 1;
+			}
+
+			auto& entry = entries[refreshCursor];
+			if (GetBound(a_source, entry.bound.handle, entry.bound) && isTracked(entry.bound)) {
+				refreshCursor++;
+				continue;
+			}
+
+			// swap with the last entry, which gets refreshed next
+			tracked.erase(entry.bound.handle);
+			if (refreshCursor != entries.size() - 1) {
+				entry = std::move(entries.back());
+				tracked[entry.bound.handle] = refreshCursor;
+			}
+			entries.pop_back();
+		}
+
+		// pick up newly processed actors a few handles at a time
+		const auto handleCount = a_source->GetHandleCount();
+		for (std::size_t i = 0; i < discoverCount && i < handleCount; i++) {
+			if (discoverCursor >= handleCount) {
+				discoverCursor = 0;
+			}
+
+			const auto handle = a_source->GetHandle(discoverCursor++);
+			if (handle == Engine::IActorSource::player || tracked.contains(handle)) {
+				continue;
+			}
+
+			Bound bound;
+			if (GetBound(a_source, handle, bound) && isTracked(bound)) {
+				tracked.emplace(handle, entries.size());
+				entries.push_back({ bound });
+			}
+		}
+
+		Relink();
+	}
+
+	void Index::Clear()
+	{
+		entries.clear();
+		tracked.clear();
+		buckets.fill(-1);
+		refreshCursor = 0;
+		discoverCursor = 0;
+	}
+
+	void Index::GetAll(std::vector<Bound>& a_bounds) const
+	{
+		a_bounds.clear();
+		for (const auto& entry : entries) {
+			a_bounds.push_back(entry.bound);
+		}
+	}
+
+	void Index::Assign(const std::vector<Bound>& a_bounds)
+	{
+		Clear();
+
+		// the player's entry comes first, as Update keeps it
+		for (const auto& bound : a_bounds) {
+			if (!entries.empty()) {
+				tracked.emplace(bound.handle, entries.size());
+			}
+			entries.push_back({ bound });
+		}
+
+		Relink();
+	}
+
+	void Index::Relink()
+	{
+		buckets.fill(-1);
+
+		for (std::size_t i = 0; i < entries.size(); i++) {
+			auto& entry = entries[i];
+			if (entry.bound.height <= 0.0f) {
+				continue;
+			}
+
+			auto& head = buckets[Hash(GetBucketCoord(entry.bound.position.x), GetBucketCoord(entry.bound.position.y))];
+			entry.next = head;
+			head = static_cast<std::int32_t>(i);
+		}
+	}
+
+	template <class F>
+	void Index::ForEachNear(float a_x, float a_y, float a_radius, F&& a_func) const
+	{
+		const auto margin = a_radius + maxRadius;
+		const auto minX = GetBucketCoord(a_x - margin);
+		const auto maxX = GetBucketCoord(a_x + margin);
+		const auto minY = GetBucketCoord(a_y - margin);
+		const auto maxY = GetBucketCoord(a_y + margin);
+
+		for (auto y = minY; y <= maxY; y++) {
+			for (auto x = minX; x <= maxX; x++) {
+				for (auto i = buckets[Hash(x, y)]; i >= 0; i = entries[i].next) {
+					const auto& bound = entries[i].bound;
+
+					// other cells share the bucket, only visit each entry from its own cell
+					if (GetBucketCoord(bound.position.x) != x || GetBucketCoord(bound.position.y) != y) {
+						continue;
+					}
+
+					const auto dx = bound.position.x - a_x;
+					const auto dy = bound.position.y - a_y;
+					const auto reach = a_radius + bound.radius;
+					if (dx * dx + dy * dy < reach * reach && a_func(bound)) {
+						return;
+					}
+				}
+			}
+		}
+	}
+
+	void Index::GetBounds(float a_x, float a_y, float a_radius, std::vector<Bound>& a_bounds) const
+	{
+		a_bounds.clear();
+		ForEachNear(a_x, a_y, a_radius, [&](const Bound& a_bound) {
+			a_bounds.push_back(a_bound);
+			return false;
+		});
+	}
+
+	bool Index::IsNear(float a_x, float a_y, float a_radius) const
+	{
+		bool found = false;
+		ForEachNear(a_x, a_y, a_radius, [&](const Bound&) {
+			found = true;
+			return true;
+		});
+		return found;
+	}
+}
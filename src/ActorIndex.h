@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Engine.h"
+
+namespace Actors
+{
+	// upright cylinder around an actor, rain only lands on its top half
+	struct Bound
+	{
+		Engine::IActorSource::Handle handle{ Engine::IActorSource::player };  // to look the actor up again where it is now
+		Engine::Point3               position{};                            // feet
+		float                        radius{ 0.0f };
+		float                        height{ 0.0f };
+
+		[[nodiscard]] bool operator==(const Bound&) const = default;
+	};
+
+	// spatial hash of the high process actors around the player, a few of them refreshed each frame
+	class Index : public ISingleton<Index>
+	{
+	public:
+		Index();
+
+		// once per frame on the main thread
+		void Update(const Engine::IActorSource* a_source, const Engine::Point3& a_playerPos);
+		void Clear();
+
+		// every tracked bound, and replacing them outright; traces carry the index instead of the actors behind it
+		void GetAll(std::vector<Bound>& a_bounds) const;
+		void Assign(const std::vector<Bound>& a_bounds);
+
+		// actors whose footprint overlaps the circle, as of their last refresh
+		void GetBounds(float a_x, float a_y, float a_radius, std::vector<Bound>& a_bounds) const;
+		[[nodiscard]] bool IsNear(float a_x, float a_y, float a_radius) const;
+
+		[[nodiscard]] std::size_t GetCount() const { return entries.size(); }
+
+		// current bound, clamped like the tracked ones; false once the actor unloaded or died
+		static bool GetBound(const Engine::IActorSource* a_source, Engine::IActorSource::Handle a_handle, Bound& a_bound);
+
+	private:
+		struct Entry
+		{
+			Bound        bound;
+			std::int32_t next{ -1 };  // next entry in the same bucket
+		};
+
+		static constexpr float       bucketSize{ 512.0f };
+		static constexpr std::size_t bucketCount{ 256 };  // power of two
+		static constexpr float       trackRadius{ 4096.0f };
+		static constexpr std::size_t refreshCount{ 16 };   // tracked actors refreshed per frame
+		static constexpr std::size_t discoverCount{ 32 };  // process list handles checked per frame
+		static constexpr float       maxRadius{ 128.0f };  // clamps giants so the query margin stays small
+
+		[[nodiscard]] static std::int32_t GetBucketCoord(float a_pos);
+		[[nodiscard]] static std::size_t  Hash(std::int32_t a_x, std::int32_t a_y);
+
+		void Relink();
+
+		template <class F>
+		void ForEachNear(float a_x, float a_y, float a_radius, F&& a_func) const;
+
+		std::vector<Entry>                             entries;
+		std::array<std::int32_t, bucketCount>          buckets{};  // first entry per bucket, -1 if empty
+		std::unordered_map<std::uint32_t, std::size_t> tracked;    // handle -> entry
+		std::size_t                                    refreshCursor{ 0 };
+		std::size_t                                    discoverCursor{ 0 };
+	};
+}
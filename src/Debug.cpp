@@ -1,5 +1,14 @@
 #include "Debug.h"
+#include "Exposure.h"
+#include "Game.h"
+#include "HeightCache.h"
+#include "Jobs.h"
+#include "Particles.h"
 #include "Settings.h"
+#include "Surface.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Util.h"
 
 namespace Debug
 {
@@ -14,27 +23,135 @@ namespace Debug
 				std::string buf;
 				buf += "Reload Splashes of Storms settings from config\n";
 				buf += R"(<id> : 0 - clear weather | 1 - light rain | 2 -  medium rain | 3 - heavy rain | 4 - blizzard )";
+				buf += "\n";
+				buf += R"(stats [csv] : print per-frame cost and per-tier rates for recent frames, optionally dumping them to po3_SplashesOfStorms_stats.csv)";
 				return buf;
 			}();
 			return help;
 		}
 
+		constexpr auto print = [](const char* a_fmt) {
+			if (RE::ConsoleLog::IsConsoleMode()) {
+				RE::ConsoleLog::GetSingleton()->Print(a_fmt);
+			}
+		};
+
+		void PrintStats()
+		{
+			if (const auto heightCache = RayCast::HeightCache::GetSingleton(); heightCache->GetLookups() > 0) {
+				const auto stats = fmt::format("Height cache : {:.1f}% hit rate, {} rays saved", heightCache->GetHitRate() * 100.0f, heightCache->GetRaysSaved());
+				print(fmt::format("[Splashes of Storms] {}", stats).c_str());
+				logger::info("{}", stats);
+			}
+
+			if (const auto pool = Particles::Pool::GetSingleton(); pool->GetCounters().spawns > 0) {
+				const auto& counters = pool->GetCounters();
+				const auto  stats = fmt::format("Splash pool : {} spawns, {} allocated, {} recycled, {:.2f}us avg spawn, {}/{} live, {} evicted, {} skipped", counters.spawns, counters.allocations, counters.recycles, counters.GetAverageLatency(), pool->GetLiveCount(), pool->GetBudget(), counters.evictions, counters.skips);
+				print(fmt::format("[Splashes of Storms] {}", stats).c_str());
+				logger::info("{}", stats);
+			}
+
+			if (const auto exposure = Exposure::Manager::GetSingleton(); exposure->GetLookups() > 0) {
+				const auto stats = fmt::format("Exposure maps : {:.1f}% hit rate, {} tiles ({} unsaved)", exposure->GetHitRate() * 100.0f, exposure->GetTileCount(), exposure->GetBuiltTileCount());
+				print(fmt::format("[Splashes of Storms] {}", stats).c_str());
+				logger::info("{}", stats);
+			}
+
+			if (const auto batch = RayCast::Batch::GetSingleton(); batch->GetAsyncQueries() > 0) {
+				const auto stats = fmt::format("Async raycasts : {} queries on {} workers, {} steals, {} frames fell back to sync, {} chunks deferred by the world lock", batch->GetAsyncQueries(), Jobs::Pool::GetSingleton()->GetWorkerCount(), Jobs::Pool::GetSingleton()->GetSteals(), batch->GetSyncFallbacks(), batch->GetDeferredChunks());
+				print(fmt::format("[Splashes of Storms] {}", stats).c_str());
+				logger::info("{}", stats);
+			}
+
+			if (const auto& fastPath = Ripples::Dynamic::fastPathStats; fastPath.time > 0.0f) {
+				const auto stats = fmt::format("Ripple fast path : {:.0f} raycasts saved/s, {:.0f} shelter probes/s", fastPath.raysSaved / fastPath.time, fastPath.probes / fastPath.time);
+				print(fmt::format("[Splashes of Storms] {}", stats).c_str());
+				logger::info("{}", stats);
+			}
+		}
+
+		void PrintFrameStats(bool a_dumpCSV)
+		{
+			const auto tracker = Stats::Tracker::GetSingleton();
+			const auto report = tracker->GetReport();
+			if (report.frames == 0) {
+				print("[Splashes of Storms] No frames recorded yet");
+				return;
+			}
+
+			const auto log = [](const std::string& a_stats) {
+				print(fmt::format("[Splashes of Storms] {}", a_stats).c_str());
+				logger::info("{}", a_stats);
+			};
+
+			log(fmt::format("Frame cost ({} frames) : p50 {:.3f}ms, p95 {:.3f}ms, p99 {:.3f}ms, max {:.3f}ms", report.frames, report.p50, report.p95, report.p99, report.max));
+
+			constexpr std::array tierNames{ "None"sv, "Light"sv, "Medium"sv, "Heavy"sv, "Snow"sv };
+			for (std::size_t i = 0; i < report.tiers.size(); i++) {
+				const auto& tier = report.tiers[i];
+				if (tier.frames == 0 || i == std::to_underlying(Rain::TYPE::kNone) || i == std::to_underlying(Rain::TYPE::kInvalid)) {
+					continue;
+				}
+				using Stats::COUNTER;
+				log(fmt::format("{} rain ({} frames) : {:.0f} splash rays/s ({:.0f} frustum rejects/s), {:.0f} ripple rays/s ({:.0f} shared with splashes), {:.0f} shelter probes/s, {:.0f} actor probes/s",
+					tierNames[i], tier.frames, tier.GetRate(COUNTER::kSplashRays), tier.GetRate(COUNTER::kFrustumRejects), tier.GetRate(COUNTER::kRippleRays), tier.GetRate(COUNTER::kSharedRays), tier.GetRate(COUNTER::kShelterProbes), tier.GetRate(COUNTER::kActorProbes)));
+				log(fmt::format("{} rain hits : {:.0f} surface/s, {:.0f} actor/s, {:.0f} water/s, {:.0f} misses/s, {:.0f} cached/s, {:.0f} mapped/s, {:.1f}% surface cache hits -> {:.0f} splashes/s ({:.0f} evicted/s, {:.0f} over budget/s), {:.0f} ripples/s, {:.4f}% screen coverage per splash ray",
+					tierNames[i], tier.GetRate(COUNTER::kSurfaceHits), tier.GetRate(COUNTER::kActorHits), tier.GetRate(COUNTER::kWaterHits), tier.GetRate(COUNTER::kMisses), tier.GetRate(COUNTER::kCacheHits), tier.GetRate(COUNTER::kExposureHits), tier.GetSurfaceCacheHitRate() * 100.0f,
+					tier.GetRate(COUNTER::kSplashes), tier.GetRate(COUNTER::kEvictions), tier.GetRate(COUNTER::kBudgetSkips), tier.GetRate(COUNTER::kRipples), tier.GetCoveragePerRay() * 100.0));
+				log(fmt::format("{} rain queries : {:.0f} havok queries/s, {:.0f} units per query, {:.0f} fallbacks/s, {:.2f}us per main thread query, {:.0f} moved to a neighbouring cell/s, {:.0f} lost to unloaded cells/s",
+					tierNames[i], tier.GetRate(COUNTER::kRayQueries), tier.GetAverageRayLength(), tier.GetRate(COUNTER::kRayFallbacks), tier.GetAverageQueryTime(), tier.GetRate(COUNTER::kCellTransfers), tier.GetRate(COUNTER::kUnloadedRays)));
+			}
+
+			if (a_dumpCSV) {
+				if (const auto path = Stats::GetDefaultCSVPath(); !path.empty() && tracker->DumpCSV(path)) {
+					log(fmt::format("Dumped {} frames to {}", report.frames, path.filename().string()));
+				} else {
+					print("[Splashes of Storms] Failed to write stats csv, check po3_SplashesOfStorms.log for more info");
+				}
+			}
+		}
+
 		bool Execute(const RE::SCRIPT_PARAMETER*, RE::SCRIPT_FUNCTION::ScriptData* a_scriptData, RE::TESObjectREFR*, RE::TESObjectREFR*, RE::Script*, RE::ScriptLocals*, double&, std::uint32_t&)
 		{
-			constexpr auto print = [](const char* a_fmt) {
-				if (RE::ConsoleLog::IsConsoleMode()) {
-					RE::ConsoleLog::GetSingleton()->Print(a_fmt);
+			std::string arg;
+			std::string option;
+			if (a_scriptData->numParams > 0) {
+				const auto chunk = a_scriptData->GetStringChunk();
+				arg = chunk->GetString();
+				if (a_scriptData->numParams > 1) {
+					option = chunk->GetNext()->AsString()->GetString();
 				}
-			};
+			}
+
+			if (string::iequals(arg, "stats"sv)) {
+				PrintStats();
+				PrintFrameStats(string::iequals(option, "csv"sv));
+				return true;
+			}
 
 			print("[Splashes of Storms] Reloading settings..");
 
 			logger::info("******************************");
 			logger::info("Reloading settings..");
 
-			if (Settings::Manager::GetSingleton()->LoadSettings()) {
+			const auto settings = Settings::Manager::GetSingleton();
+			if (settings->LoadSettings()) {
+				if (settings->Get()->traceMode == Settings::TRACE_MODE::kReplay) {
+					if (const auto result = Trace::Replay(Trace::GetDefaultPath()); result && result->frames > 0) {
+						const auto stats = fmt::format("Trace replay : {} frames, {} raycasts ({} hits), {} splashes, {} ripples, {:.4f}% screen coverage per raycast, {:.3f}ms avg / {:.3f}ms max frame",
+							result->frames, result->rayCasts, result->rayHits, result->spawns, result->ripples, result->rayCasts > 0 ? result->coverage / result->rayCasts * 100.0 : 0.0,
+							result->time / result->frames, result->maxFrameTime);
+						print(fmt::format("[Splashes of Storms] {}", stats).c_str());
+						logger::info("{}", stats);
+					} else {
+						print("[Splashes of Storms] Trace replay failed, check po3_SplashesOfStorms.log for more info");
+					}
+				}
+				std::int32_t id = -1;
+				std::from_chars(arg.data(), arg.data() + arg.size(), id);
+
 				std::string weather;
-				switch (a_scriptData->GetIntegerChunk()->GetInteger()) {
+				switch (id) {
 				case 0:
 					weather = "SkyrimClear";
 					break;
@@ -72,7 +189,8 @@ namespace Debug
 	{
 		if (const auto function = RE::SCRIPT_FUNCTION::LocateConsoleCommand("CheckMemory"); function) {
 			static RE::SCRIPT_PARAMETER params[] = {
-				{ "Integer", RE::SCRIPT_PARAM_TYPE::kInt, true }
+				{ "String", RE::SCRIPT_PARAM_TYPE::kChar, true },
+				{ "String", RE::SCRIPT_PARAM_TYPE::kChar, true }
 			};
 
 			function->functionName = detail::LONG_NAME.data();
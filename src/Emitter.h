@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Engine.h"
+#include "RayBatch.h"
+#include "Stats.h"
+#include "Util.h"
+
+namespace RayCast
+{
+	// fixed for the whole drain, shared by every ray in it
+	struct EmitContext
+	{
+		std::optional<Engine::CameraState> camera;
+	};
+
+	// what gets spawned for a resolved ray, each policy only takes hits on its own side of the water surface
+	namespace Policies
+	{
+		struct Splash
+		{
+			static constexpr bool water{ false };
+
+			static void Spawn(const Batch::Ray& a_ray, const Output& a_output, const EmitContext& a_context)
+			{
+				const auto& splash = a_ray.rain->splash;
+
+				const auto& model = a_output.hitActor ? splash.nifActor : splash.GetNif(a_output.surface);
+				const float scale = (a_output.hitActor ? splash.nifScaleActor : splash.nifScale) * a_ray.scale;
+
+				const auto tracker = Stats::Tracker::GetSingleton();
+				tracker->Add(Stats::COUNTER::kSplashes);
+				if (a_context.camera) {
+					tracker->AddCoverage(Stats::GetScreenCoverage(*a_context.camera, a_output.hitPos, scale));
+				}
+
+				Engine::Get().particles->Spawn(a_ray.cell, model.c_str(), a_output.yaw, a_output.hitPos, scale);
+			}
+		};
+
+		struct Ripple
+		{
+			static constexpr bool water{ true };
+
+			static void Spawn(const Batch::Ray& a_ray, const Output& a_output, const EmitContext&)
+			{
+				Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kRipples);
+				Engine::Get().waterSystem->AddRipple(a_output.hitPos, a_ray.rain->ripple.rippleDisplacementAmount * 0.0099999998f);
+			}
+		};
+
+		// stands in for a splash or ripple policy, drops a marker wherever it would have spawned
+		template <bool WATER>
+		struct DebugMarker
+		{
+			static constexpr bool water{ WATER };
+
+			static void Spawn(const Batch::Ray& a_ray, const Output& a_output, const EmitContext&)
+			{
+				Engine::Get().particles->Spawn(a_ray.cell, Engine::IParticleSpawner::debugMarker, a_output.yaw, a_output.hitPos, 0.5f);
+			}
+		};
+	}
+
+	template <class Policy>
+	struct Emitter
+	{
+		static void Emit(const Batch::Ray& a_ray, const Output& a_output, const EmitContext& a_context)
+		{
+			if (a_output.hitWater == Policy::water) {
+				Policy::Spawn(a_ray, a_output, a_context);
+			}
+		}
+	};
+
+	// routes each ray type to its emitter; the drain picks one instantiation per frame from the debug marker and shared ray settings,
+	// so nothing below branches on settings
+	template <class SplashPolicy, class RipplePolicy, bool SHARED>
+	struct Router
+	{
+		static_assert(!SplashPolicy::water && RipplePolicy::water);
+
+		using SplashEmitter = Emitter<SplashPolicy>;
+		using RippleEmitter = Emitter<RipplePolicy>;
+
+		static void Emit(const Batch::Ray& a_ray, const Output& a_output, const EmitContext& a_context)
+		{
+			switch (a_ray.type) {
+			case Batch::TYPE::kSplash:
+				SplashEmitter::Emit(a_ray, a_output, a_context);
+				break;
+			case Batch::TYPE::kRipple:
+				RippleEmitter::Emit(a_ray, a_output, a_context);
+				break;
+			case Batch::TYPE::kShared:
+				// only queued while sharing is on, a reload between queueing and draining drops them like an unloaded cell would
+				if constexpr (SHARED) {
+					SplashEmitter::Emit(a_ray, a_output, a_context);
+					RippleEmitter::Emit(a_ray, a_output, a_context);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		// unsheltered probe, its origin is already on the water surface or the actor
+		static void EmitProbe(const Batch::Ray& a_ray, const EmitContext& a_context)
+		{
+			Output output;
+			output.hitPos = a_ray.origin;
+			output.yaw = RNG::GetSingleton()->generate(-Engine::PI, Engine::PI);
+			if (a_ray.type == Batch::TYPE::kActorProbe) {
+				output.hitActor = true;
+				SplashPolicy::Spawn(a_ray, output, a_context);
+			} else {
+				output.hitWater = true;
+				RipplePolicy::Spawn(a_ray, output, a_context);
+			}
+		}
+	};
+}
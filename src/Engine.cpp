@@ -0,0 +1,569 @@
+#include "Engine.h"
+#include "Game.h"
+#include "Particles.h"
+#include "Surface.h"
+
+namespace Engine
+{
+	static_assert(std::to_underlying(Surface::MATERIAL::kStone) == std::to_underlying(RE::MATERIAL_ID::kStone));
+	static_assert(std::to_underlying(Surface::MATERIAL::kWood) == std::to_underlying(RE::MATERIAL_ID::kWood));
+	static_assert(std::to_underlying(Surface::MATERIAL::kMetalSolid) == std::to_underlying(RE::MATERIAL_ID::kMetalSolid));
+	static_assert(std::to_underlying(Surface::MATERIAL::kGrass) == std::to_underlying(RE::MATERIAL_ID::kGrass));
+	static_assert(std::to_underlying(Surface::MATERIAL::kSnow) == std::to_underlying(RE::MATERIAL_ID::kSnow));
+
+	namespace Game
+	{
+		HIT GetHitType(RE::COL_LAYER a_layer)
+		{
+			switch (a_layer) {
+			case RE::COL_LAYER::kCharController:
+			case RE::COL_LAYER::kBiped:
+			case RE::COL_LAYER::kDeadBip:
+			case RE::COL_LAYER::kBipedNoCC:
+				return HIT::kActor;
+			case RE::COL_LAYER::kStatic:
+			case RE::COL_LAYER::kTerrain:
+			case RE::COL_LAYER::kTrees:
+			case RE::COL_LAYER::kGround:
+				return HIT::kStatic;
+			default:
+				return HIT::kDynamic;
+			}
+		}
+
+		// the one thing RE::BSReadWriteLock's public API (LockForRead, UnlockForRead, ...) lacks: a read acquire that gives up on a writer
+		// instead of spinning; only the acquire is done here, releasing still goes through UnlockForRead
+		// relies on the game's protocol, as implemented by BSReadWriteLock::LockForRead/LockForWrite in SE 1.5.97, AE 1.6.640 and
+		// VR 1.4.15 (the runtimes the hooks target) and reversed in CommonLibSSE:
+		//   writerThread  id of the thread holding it for writing, only ever written by that thread; never read here
+		//   lock          reader count, with kWriteFlag set while a writer holds it
+		//   readers CAS lock from n to n + 1 while kWriteFlag is clear, and atomically decrement it to release
+		//   writers CAS lock from 0 to kWriteFlag, so a reader that got in first keeps them out until it releases
+		class ReadLock
+		{
+		public:
+			[[nodiscard]] static bool TryAcquire(RE::BSReadWriteLock& a_lock)
+			{
+				std::atomic_ref lock(reinterpret_cast<Layout&>(a_lock).lock);
+
+				for (auto value = lock.load(std::memory_order_relaxed); (value & kWriteFlag) == 0;) {
+					if (lock.compare_exchange_weak(value, value + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+		private:
+			static constexpr std::uint32_t kWriteFlag{ 0x80000000 };
+
+			// RE::BSReadWriteLock keeps its members private, this mirrors them; any change to its layout fails here
+			struct Layout
+			{
+				std::uint32_t writerThread;  // 00
+				std::uint32_t lock;          // 04
+			};
+			static_assert(std::is_standard_layout_v<RE::BSReadWriteLock>);
+			static_assert(sizeof(Layout) == sizeof(RE::BSReadWriteLock));
+			static_assert(alignof(Layout) == alignof(RE::BSReadWriteLock));
+			static_assert(offsetof(Layout, writerThread) == 0x0);
+			static_assert(offsetof(Layout, lock) == 0x4);
+			static_assert(std::atomic_ref<std::uint32_t>::is_always_lock_free);
+		};
+
+		class RayCaster final : public IRayCaster
+		{
+		public:
+			static constexpr RE::hkpShapeKey invalidShapeKey{ 0xFFFFFFFF };
+
+			const void* GetWorld(Cell* a_cell) const override
+			{
+				return a_cell ? FromCell(a_cell)->GetbhkWorld() : nullptr;
+			}
+
+			std::optional<RayHit> CastRay(Cell* a_cell, const Point3& a_from, const Point3& a_to) override
+			{
+				const auto bhkWorld = a_cell ? FromCell(a_cell)->GetbhkWorld() : nullptr;
+				if (!bhkWorld) {
+					return std::nullopt;
+				}
+
+				RE::BSReadLockGuard locker(bhkWorld->worldLock);
+				return Pick(bhkWorld, GetFilterInfo(), a_from, a_to);
+			}
+
+			// held by the queries, so the world outlives a cell that unloads while they are out on the workers
+			// the pick filter is taken here on the main thread and travels with the reference
+			WorldRef AcquireWorld(Cell* a_cell) override
+			{
+				const auto bhkWorld = a_cell ? FromCell(a_cell)->GetbhkWorld() : nullptr;
+				if (!bhkWorld) {
+					return nullptr;
+				}
+
+				bhkWorld->IncRefCount();
+				return WorldRef(bhkWorld, WorldHolder{ GetFilterInfo() });
+			}
+
+			bool TryLockWorld(const WorldRef& a_world) override
+			{
+				return ReadLock::TryAcquire(ToWorld(a_world)->worldLock);
+			}
+
+			void UnlockWorld(const WorldRef& a_world) override
+			{
+				ToWorld(a_world)->worldLock.UnlockForRead();
+			}
+
+			std::optional<RayHit> CastRay(const WorldRef& a_world, const Point3& a_from, const Point3& a_to) override
+			{
+				return Pick(ToWorld(a_world), std::get_deleter<WorldHolder>(a_world)->filterInfo, a_from, a_to);
+			}
+
+			bool SupportsConcurrentQueries() const override { return true; }
+
+			// terrain extents plus the bounding spheres of every loaded reference
+			std::optional<HeightRange> GetHeightRange(Cell* a_cell) const override
+			{
+				const auto cell = FromCell(a_cell);
+				if (!cell || !cell->IsAttached()) {
+					return std::nullopt;
+				}
+
+				HeightRange range{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+
+				if (const auto land = cell->cellLand; land && land->loadedData) {
+					range.min = land->loadedData->heightExtents.x;
+					range.max = land->loadedData->heightExtents.y;
+				}
+
+				RE::BSSpinLockGuard locker(cell->spinLock);
+				for (const auto& ref : cell->references) {
+					if (const auto root = ref ? ref->Get3D() : nullptr) {
+						const auto& bound = root->worldBound;
+						range.min = std::min(range.min, bound.center.z - bound.radius);
+						range.max = std::max(range.max, bound.center.z + bound.radius);
+					}
+				}
+
+				if (range.min > range.max) {
+					return std::nullopt;
+				}
+				return range;
+			}
+
+			// interiors stand alone, exteriors are looked up in the loaded grid around the player by cell coordinates
+			Cell* GetLoadedCell(Cell* a_cell, const Point3& a_pos) const override
+			{
+				return ToCell(FindLoadedCell(FromCell(a_cell), a_pos));
+			}
+
+			// the worldspace editor id isn't loaded at runtime, name it after the plugin that defines it
+			std::optional<WorldSpace> GetWorldSpace(Cell* a_cell) const override
+			{
+				const auto cell = FromCell(a_cell);
+				const auto worldSpace = cell && cell->IsExteriorCell() ? cell->worldSpace : nullptr;
+				if (!worldSpace) {
+					return std::nullopt;
+				}
+
+				const auto plugin = worldSpace->GetFile(0);
+				if (!plugin) {
+					return std::nullopt;
+				}
+
+				const auto pluginName = std::filesystem::path(plugin->GetFilename()).stem().string();
+				return WorldSpace{ worldSpace, fmt::format("{}_{:06X}", pluginName, worldSpace->GetLocalFormID()), worldSpace->GetLocalFormID() };
+			}
+
+			// references placed in a cell make their plugin override the cell record, so its file list follows the load order
+			std::uint64_t GetCellSignature(Cell* a_cell) const override
+			{
+				const auto cell = FromCell(a_cell);
+				if (!cell) {
+					return 0;
+				}
+
+				// fnv-1a over the file names in override order
+				std::uint64_t hash{ 0xCBF29CE484222325 };
+				const auto    add = [&](const RE::TESForm* a_form) {
+					for (std::int32_t i = 0; const auto file = a_form ? a_form->GetFile(i) : nullptr; i++) {
+						for (const auto c : std::string_view(file->GetFilename())) {
+							hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x100000001B3;
+						}
+						hash = (hash ^ '|') * 0x100000001B3;
+					}
+				};
+
+				add(cell);
+				add(cell->cellLand);
+
+				// scripts enable and disable placed references at runtime, actors and references spawned in game come and go on their own
+				std::uint64_t enabled{ 0 };
+				{
+					RE::BSSpinLockGuard locker(cell->spinLock);
+					for (const auto& ref : cell->references) {
+						if (ref && !ref->IsDynamicForm() && !ref->IsDisabled() && !ref->IsDeleted() && !ref->Is(RE::FormType::ActorCharacter)) {
+							// mixed, then summed so the order the references were loaded in doesn't matter
+							const auto mixed = (static_cast<std::uint64_t>(ref->GetFormID()) + 0x9E3779B97F4A7C15) * 0xBF58476D1CE4E5B9;
+							enabled += mixed ^ (mixed >> 31);
+						}
+					}
+				}
+				return (hash ^ enabled) * 0x100000001B3;
+			}
+
+		private:
+			// the WorldRef's deleter, so the reference itself still points at the world and doubles as its identity
+			struct WorldHolder
+			{
+				void operator()(RE::bhkWorld* a_world) const { a_world->DecRefCount(); }
+
+				std::uint32_t filterInfo;
+			};
+
+			static RE::bhkWorld* ToWorld(const WorldRef& a_world)
+			{
+				return static_cast<RE::bhkWorld*>(a_world.get());
+			}
+
+			// main thread only, GetNewSystemGroup bumps a counter in the collision filter
+			static std::uint32_t GetFilterInfo()
+			{
+				return RE::bhkCollisionFilter::GetSingleton()->GetNewSystemGroup() << 16 | std::to_underlying(RE::COL_LAYER::kLOS);
+			}
+
+			// world locked by the caller; the collidable may be freed once it is released, so everything is read here
+			static std::optional<RayHit> Pick(RE::bhkWorld* a_world, std::uint32_t a_filterInfo, const Point3& a_from, const Point3& a_to)
+			{
+				RE::bhkPickData pickData{};
+
+				const auto havokWorldScale = RE::bhkWorld::GetWorldScale();
+				pickData.rayInput.from = ToNiPoint(a_from) * havokWorldScale;
+				pickData.rayInput.to = ToNiPoint(a_to) * havokWorldScale;
+				pickData.rayInput.enableShapeCollectionFilter = false;
+				pickData.rayInput.filterInfo = a_filterInfo;
+
+				if (a_world->PickObject(pickData); pickData.rayOutput.HasHit()) {
+					const auto collidable = pickData.rayOutput.rootCollidable;
+					return RayHit{
+						a_from + (a_to - a_from) * pickData.rayOutput.hitFraction,
+						pickData.rayOutput.hitFraction,
+						GetHitType(static_cast<RE::COL_LAYER>(collidable->broadPhaseHandle.collisionFilterInfo & 0x7F)),
+						GetMaterial(a_world, collidable, pickData.rayOutput)
+					};
+				}
+
+				return std::nullopt;
+			}
+
+			// cached per sub-shape, the shape hierarchy is only walked the first time it is hit
+			static std::uint32_t GetMaterial(const RE::bhkWorld* a_world, const RE::hkpCollidable* a_collidable, const RE::hkpShapeRayCastOutput& a_output)
+			{
+				if (!a_collidable) {
+					return 0;
+				}
+
+				// fnv-1a over the keys, they end at the first invalid one
+				std::uint64_t shapeKey{ 0xCBF29CE484222325 };
+				for (const auto key : a_output.shapeKeys) {
+					if (key == invalidShapeKey) {
+						break;
+					}
+					shapeKey = (shapeKey ^ key) * 0x100000001B3;
+				}
+
+				const Surface::Cache::Key cacheKey{ reinterpret_cast<std::uintptr_t>(a_collidable), reinterpret_cast<std::uintptr_t>(a_collidable->GetShape()), shapeKey };
+				return Surface::Cache::GetSingleton()->Resolve(a_world, cacheKey, [&] {
+					return ReadMaterial(a_collidable, a_output);
+				});
+			}
+
+			// follows the shape keys down to the sub-shape that was hit, the deepest one with a material of its own wins
+			static std::uint32_t ReadMaterial(const RE::hkpCollidable* a_collidable, const RE::hkpShapeRayCastOutput& a_output)
+			{
+				auto       shape = a_collidable ? a_collidable->GetShape() : nullptr;
+				const auto bhkShape = shape ? reinterpret_cast<RE::bhkShape*>(shape->userData) : nullptr;
+				auto       material = bhkShape ? std::to_underlying(bhkShape->materialID) : 0;
+
+				RE::hkpShapeBuffer buffer{};
+				for (const auto key : a_output.shapeKeys) {
+					const auto container = shape && key != invalidShapeKey ? shape->GetContainer() : nullptr;
+					if (!container) {
+						break;
+					}
+					shape = container->GetChildShape(key, buffer);
+					if (const auto childShape = shape ? reinterpret_cast<RE::bhkShape*>(shape->userData) : nullptr) {
+						material = std::to_underlying(childShape->materialID);
+					}
+				}
+
+				return material;
+			}
+
+			static RE::TESObjectCELL* FindLoadedCell(RE::TESObjectCELL* a_cell, const Point3& a_pos)
+			{
+				if (!a_cell) {
+					return nullptr;
+				}
+
+				if (a_cell->IsInteriorCell()) {
+					return a_cell == RE::PlayerCharacter::GetSingleton()->GetParentCell() ? a_cell : nullptr;
+				}
+
+				constexpr auto cellSize = 4096.0f;
+
+				const auto cellX = static_cast<std::int32_t>(std::floor(a_pos.x / cellSize));
+				const auto cellY = static_cast<std::int32_t>(std::floor(a_pos.y / cellSize));
+
+				const auto owns = [&](RE::TESObjectCELL* a_candidate) {
+					if (!a_candidate || !a_candidate->IsAttached() || a_candidate->worldSpace != a_cell->worldSpace) {
+						return false;
+					}
+					const auto coordinates = a_candidate->GetCoordinates();
+					return coordinates && coordinates->cellX == cellX && coordinates->cellY == cellY;
+				};
+
+				// most rays land in the cell they were queued in
+				if (owns(a_cell)) {
+					return a_cell;
+				}
+
+				const auto tes = RE::TES::GetSingleton();
+				const auto grid = tes ? tes->gridCells : nullptr;
+				if (!grid || !grid->cells) {
+					return nullptr;
+				}
+
+				for (std::uint32_t i = 0; i < grid->length * grid->length; i++) {
+					if (const auto cell = grid->cells[i]; owns(cell)) {
+						return cell;
+					}
+				}
+
+				return nullptr;
+			}
+		};
+
+		class WaterSystem final : public IWaterSystem
+		{
+		public:
+			bool IsEnabled() const override
+			{
+				const auto waterSystem = RE::TESWaterSystem::GetSingleton();
+				return waterSystem && waterSystem->enabled;
+			}
+
+			std::size_t GetSignature() const override
+			{
+				const auto combine = [](std::size_t& a_seed, std::size_t a_value) {
+					a_seed ^= a_value + 0x9E3779B97F4A7C15 + (a_seed << 6) + (a_seed >> 2);
+				};
+
+				const auto waterSystem = RE::TESWaterSystem::GetSingleton();
+				if (!waterSystem) {
+					return 0;
+				}
+
+				// checked every drain, so only what is cheap to read: the object list, each object's bound count and the player's cell
+				std::size_t seed = waterSystem->waterObjects.size();
+				for (const auto& waterObject : waterSystem->waterObjects) {
+					combine(seed, reinterpret_cast<std::size_t>(waterObject.get()));
+					if (waterObject) {
+						combine(seed, waterObject->multiBounds.size());
+					}
+				}
+				combine(seed, reinterpret_cast<std::size_t>(RE::PlayerCharacter::GetSingleton()->GetParentCell()));
+
+				// levels rising and draining in place only move the bounds, those are walked once a second at most
+				if (seed != objectSeed || ++checks >= boundCheckInterval) {
+					objectSeed = seed;
+					checks = 0;
+					boundSeed = 0;
+					for (const auto& waterObject : waterSystem->waterObjects) {
+						if (waterObject) {
+							for (const auto& bound : waterObject->multiBounds) {
+								if (bound) {
+									for (const auto value : { bound->center.x, bound->center.y, bound->center.z, bound->size.x, bound->size.y, bound->size.z }) {
+										combine(boundSeed, std::bit_cast<std::uint32_t>(value));
+									}
+								}
+							}
+						}
+					}
+				}
+
+				combine(seed, boundSeed);
+				return seed;
+			}
+
+			void ForEachBound(const BoundVisitor& a_visitor) const override
+			{
+				const auto waterSystem = RE::TESWaterSystem::GetSingleton();
+				if (!waterSystem) {
+					return;
+				}
+
+				for (const auto& waterObject : waterSystem->waterObjects) {
+					if (waterObject) {
+						for (const auto& bound : waterObject->multiBounds) {
+							if (bound) {
+								a_visitor(ToPoint(bound->center), ToPoint(bound->size));
+							}
+						}
+					}
+				}
+			}
+
+			void AddRipple(const Point3& a_pos, float a_displacement) override
+			{
+				RE::TESWaterSystem::GetSingleton()->AddRipple(ToNiPoint(a_pos), a_displacement);
+			}
+
+		private:
+			static constexpr std::uint32_t boundCheckInterval{ 60 };  // signature checks, about a second of drains
+
+			mutable std::size_t   objectSeed{ 0 };
+			mutable std::size_t   boundSeed{ 0 };
+			mutable std::uint32_t checks{ 0 };
+		};
+
+		class Camera final : public ICamera
+		{
+		public:
+			std::optional<CameraState> GetState() const override
+			{
+				const auto camera = RE::Main::WorldRootCamera();
+				const auto playerCamera = RE::PlayerCamera::GetSingleton();
+				if (!camera || !playerCamera) {
+					return std::nullopt;
+				}
+
+				// NiCamera looks down its local X axis
+				const auto& rotate = camera->world.rotate;
+				return CameraState{
+					ToPoint(camera->world.translate),
+					{ rotate.entry[0][0], rotate.entry[1][0], rotate.entry[2][0] },
+					playerCamera->worldFOV
+				};
+			}
+
+			std::optional<Sampler::FrustumPlanes> GetFrustum() const override
+			{
+				const auto camera = RE::Main::WorldRootCamera();
+				if (!camera) {
+					return std::nullopt;
+				}
+
+				// worldToCam is the row major world -> clip matrix, extract the planes from its rows (d3d clip space, 0 <= z <= w)
+				const auto& m = camera->worldToCam;
+				const auto  row = [&](std::size_t a_row, float a_sign) {
+					return std::array<float, 4>{
+						m[3][0] + a_sign * m[a_row][0],
+						m[3][1] + a_sign * m[a_row][1],
+						m[3][2] + a_sign * m[a_row][2],
+						m[3][3] + a_sign * m[a_row][3]
+					};
+				};
+
+				Sampler::FrustumPlanes frustum;
+				frustum.planes = {
+					row(0, 1.0f),   // left
+					row(0, -1.0f),  // right
+					row(1, 1.0f),   // bottom
+					row(1, -1.0f),  // top
+					std::array<float, 4>{ m[2][0], m[2][1], m[2][2], m[2][3] },  // near
+					row(2, -1.0f)   // far
+				};
+
+				for (auto& plane : frustum.planes) {
+					const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+					if (length <= 0.0f) {
+						return std::nullopt;
+					}
+					for (auto& value : plane) {
+						value /= length;
+					}
+				}
+
+				return frustum;
+			}
+		};
+
+		class ParticleSpawner final : public IParticleSpawner
+		{
+		public:
+			void Spawn(Cell* a_cell, const char* a_model, float a_yaw, const Point3& a_position, float a_scale) override
+			{
+				RE::NiMatrix3 rotation;
+				rotation.SetEulerAnglesXYZ({ -0, -0, a_yaw });
+
+				Particles::Pool::GetSingleton()->Spawn(FromCell(a_cell), a_model, rotation, ToNiPoint(a_position), a_scale);
+			}
+		};
+
+		// handle 0 is the player, the rest are the high process actors' native handles
+		class ActorSource final : public IActorSource
+		{
+		public:
+			std::size_t GetHandleCount() const override
+			{
+				const auto processLists = RE::ProcessLists::GetSingleton();
+				return processLists ? processLists->highActorHandles.size() : 0;
+			}
+
+			Handle GetHandle(std::size_t a_index) const override
+			{
+				return RE::ProcessLists::GetSingleton()->highActorHandles[static_cast<std::uint32_t>(a_index)].native_handle();
+			}
+
+			std::optional<ActorBound> GetBound(Handle a_handle) const override
+			{
+				RE::NiPointer<RE::Actor> actor;
+				if (a_handle == player) {
+					actor.reset(RE::PlayerCharacter::GetSingleton());
+				} else {
+					RE::ActorHandle handle;
+					handle.native_handle() = a_handle;
+					actor = handle.get();
+				}
+
+				if (!actor || !actor->Is3DLoaded() || actor->IsDead()) {
+					return std::nullopt;
+				}
+
+				const auto min = actor->GetBoundMin();
+				const auto max = actor->GetBoundMax();
+				const auto scale = actor->GetScale();
+
+				return ActorBound{
+					ToPoint(actor->GetPosition()),
+					0.5f * std::max(max.x - min.x, max.y - min.y) * scale,
+					(max.z - min.z) * scale
+				};
+			}
+		};
+
+		class TaskQueue final : public ITaskQueue
+		{
+		public:
+			void AddTask(std::function<void()> a_task) override
+			{
+				SKSE::GetTaskInterface()->AddTask(std::move(a_task));
+			}
+		};
+	}
+
+	Interfaces& Get()
+	{
+		static Game::RayCaster       rayCaster;
+		static Game::WaterSystem     waterSystem;
+		static Game::Camera          camera;
+		static Game::ParticleSpawner particles;
+		static Game::TaskQueue       tasks;
+		static Game::ActorSource     actors;
+
+		static Interfaces interfaces{ &rayCaster, &waterSystem, &camera, &particles, &tasks, &actors };
+		return interfaces;
+	}
+}
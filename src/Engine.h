@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Sampler.h"
+#include "Types.h"
+
+// thin seam between the rain pipeline and the game singletons, so the pipeline can also be driven by synthetic scenes
+// only plain data crosses it, the game side converts to and from its own types
+namespace Engine
+{
+	// what a ray stopped on, collapsed from the collision layers
+	enum class HIT : std::uint8_t
+	{
+		kStatic,   // never moves: statics, terrain, trees, ground
+		kDynamic,  // clutter, doors, anything havok may move
+		kActor
+	};
+
+	// everything needed from the hit body is read while the world is locked, it may be freed right after
+	struct RayHit
+	{
+		Point3        position{};
+		float         fraction{ 0.0f };
+		HIT           type{ HIT::kStatic };
+		std::uint32_t material{ 0 };  // havok material of the sub-shape that was hit, see Surface::MATERIAL
+	};
+
+	// keeps a physics world alive while workers query it, along with anything the queries need from the main thread
+	using WorldRef = std::shared_ptr<void>;
+
+	struct HeightRange
+	{
+		float min{ 0.0f };
+		float max{ 0.0f };
+	};
+
+	struct CameraState
+	{
+		Point3 position{};
+		Point3 forward{};
+		float  fov{ 0.0f };  // horizontal, degrees
+	};
+
+	// exterior worldspace a cell belongs to
+	struct WorldSpace
+	{
+		const void*   id{ nullptr };  // identity only
+		std::string   name;           // stable across sessions, used to name files
+		std::uint32_t formID{ 0 };    // local form id
+	};
+
+	// upright cylinder around an actor
+	struct ActorBound
+	{
+		Point3 position{};  // feet
+		float  radius{ 0.0f };
+		float  height{ 0.0f };
+	};
+
+	class IRayCaster
+	{
+	public:
+		virtual ~IRayCaster() = default;
+
+		// opaque identity of the physics world the cell lives in, null if it has none
+		[[nodiscard]] virtual const void* GetWorld(Cell* a_cell) const = 0;
+		// main thread only, locks the world for the cast
+		virtual std::optional<RayHit> CastRay(Cell* a_cell, const Point3& a_from, const Point3& a_to) = 0;
+
+		// main thread only, the reference can then be handed to workers
+		[[nodiscard]] virtual WorldRef AcquireWorld(Cell* a_cell) = 0;
+		// read lock without blocking, false while the world is being written to (stepped); workers hand the rays back to the main thread then
+		[[nodiscard]] virtual bool TryLockWorld(const WorldRef&) { return true; }
+		virtual void               UnlockWorld(const WorldRef&) {}
+		// with the world locked by TryLockWorld
+		virtual std::optional<RayHit> CastRay(const WorldRef& a_world, const Point3& a_from, const Point3& a_to) = 0;
+
+		// whether the WorldRef overloads may be called from worker threads, recording/replaying casters rely on call order
+		[[nodiscard]] virtual bool SupportsConcurrentQueries() const { return false; }
+
+		// lowest and highest collision in the cell, nullopt if unknown so rays keep their full length
+		[[nodiscard]] virtual std::optional<HeightRange> GetHeightRange(Cell*) const { return std::nullopt; }
+
+		// loaded cell that owns the position, given the cell the ray was queued in; null if it has unloaded since
+		// synthetic scenes only have the one cell
+		[[nodiscard]] virtual Cell* GetLoadedCell(Cell* a_cell, const Point3&) const { return a_cell; }
+
+		// exterior worldspace of the cell, nullopt for interiors
+		[[nodiscard]] virtual std::optional<WorldSpace> GetWorldSpace(Cell*) const { return std::nullopt; }
+
+		// hash of what may have placed collision in the cell (the plugins editing it, its land and which references are enabled), 0 if unknown
+		[[nodiscard]] virtual std::uint64_t GetCellSignature(Cell*) const { return 0; }
+	};
+
+	class IWaterSystem
+	{
+	public:
+		using BoundVisitor = std::function<void(const Point3& a_center, const Point3& a_size)>;
+
+		virtual ~IWaterSystem() = default;
+
+		[[nodiscard]] virtual bool        IsEnabled() const = 0;
+		[[nodiscard]] virtual std::size_t GetSignature() const = 0;  // changes with the water object list or its bounds, cheap enough to check every drain
+		virtual void                      ForEachBound(const BoundVisitor& a_visitor) const = 0;
+		virtual void                      AddRipple(const Point3& a_pos, float a_displacement) = 0;
+	};
+
+	class ICamera
+	{
+	public:
+		virtual ~ICamera() = default;
+
+		[[nodiscard]] virtual std::optional<CameraState>            GetState() const = 0;
+		[[nodiscard]] virtual std::optional<Sampler::FrustumPlanes> GetFrustum() const = 0;
+	};
+
+	class IParticleSpawner
+	{
+	public:
+		static constexpr auto debugMarker{ "MarkerX.nif" };
+
+		virtual ~IParticleSpawner() = default;
+
+		// a_yaw turns the model about the vertical axis, radians
+		virtual void Spawn(Cell* a_cell, const char* a_model, float a_yaw, const Point3& a_position, float a_scale) = 0;
+	};
+
+	class ITaskQueue
+	{
+	public:
+		virtual ~ITaskQueue() = default;
+
+		virtual void AddTask(std::function<void()> a_task) = 0;
+	};
+
+	// the player plus the high process actors, by handle so they can be looked up again once they have moved
+	class IActorSource
+	{
+	public:
+		using Handle = std::uint32_t;
+
+		static constexpr Handle player{ 0 };
+
+		virtual ~IActorSource() = default;
+
+		[[nodiscard]] virtual std::size_t GetHandleCount() const = 0;
+		[[nodiscard]] virtual Handle      GetHandle(std::size_t a_index) const = 0;
+
+		// current bound, nullopt once the actor unloaded or died
+		[[nodiscard]] virtual std::optional<ActorBound> GetBound(Handle a_handle) const = 0;
+	};
+
+	struct Interfaces
+	{
+		IRayCaster*       rayCaster;
+		IWaterSystem*     waterSystem;
+		ICamera*          camera;
+		IParticleSpawner* particles;
+		ITaskQueue*       tasks;
+		IActorSource*     actors;
+	};
+
+	// game backed by default, a headless driver can swap in its own implementations
+	Interfaces& Get();
+}
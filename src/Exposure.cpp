@@ -0,0 +1,456 @@
+#include "Exposure.h"
+#include "ActorIndex.h"
+#include "Jobs.h"
+#include "MappedFile.h"
+
+namespace Exposure
+{
+	namespace detail
+	{
+		struct Header
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t worldSpace;  // local form id, the plugin is in the file name
+			std::uint32_t samplesPerAxis;
+			float         cellSize;
+			std::uint32_t tileCount;
+		};
+
+		struct DirectoryEntry
+		{
+			std::int16_t  x;
+			std::int16_t  y;
+			std::uint32_t offset;     // from the start of the file
+			std::uint64_t signature;  // cell content the tile was built from
+		};
+
+		static_assert(sizeof(Header) % alignof(DirectoryEntry) == 0 && sizeof(Header) % alignof(Tile) == 0 && sizeof(DirectoryEntry) % alignof(Tile) == 0);
+
+		std::int32_t GetCellCoord(float a_pos)
+		{
+			return static_cast<std::int32_t>(std::floor(a_pos / cellSize));
+		}
+	}
+
+	Manager::Manager() = default;
+
+	Manager::~Manager() = default;
+
+	Manager::Key Manager::MakeKey(std::int32_t a_cellX, std::int32_t a_cellY)
+	{
+		return (static_cast<Key>(static_cast<std::uint16_t>(a_cellX)) << 16) | static_cast<std::uint16_t>(a_cellY);
+	}
+
+	std::filesystem::path Manager::GetPath(const Engine::WorldSpace& a_worldSpace)
+	{
+		if (a_worldSpace.name.empty()) {
+			return {};
+		}
+
+		return fmt::format("Data/SKSE/Plugins/{}/{}.exposure", Version::PROJECT, a_worldSpace.name);
+	}
+
+	template <class Target>
+	void Manager::CastSamples(Engine::IRayCaster* a_rayCaster, const Target& a_target, Build& a_build, std::size_t a_count)
+	{
+		constexpr auto height = 9999.0f;
+
+		auto& tile = *a_build.tile;
+
+		const auto end = std::min(a_build.next + a_count, samplesPerTile);
+		for (; a_build.next < end; a_build.next++) {
+			const auto i = a_build.next;
+			const auto x = a_build.originX + (static_cast<float>(i % samplesPerAxis) + 0.5f) * sampleSpacing;
+			const auto y = a_build.originY + (static_cast<float>(i / samplesPerAxis) + 0.5f) * sampleSpacing;
+
+			const auto hit = a_rayCaster->CastRay(a_target, { x, y, a_build.z + height }, { x, y, a_build.z - height });
+			// only surfaces that never move are mapped, anything else is left to havok
+			if (hit && hit->type == Engine::HIT::kStatic) {
+				tile.heights[i] = hit->position.z;
+				tile.flags[i] = Tile::kValid | std::to_underlying(Surface::GetType(hit->material));
+			}
+		}
+	}
+
+	void Manager::BuildChunk(Engine::IRayCaster* a_rayCaster, std::shared_ptr<Pending> a_pending, std::shared_ptr<Build> a_build, std::size_t a_chunkSize)
+	{
+		// nobody will look the tile up anymore
+		if (a_build->generation != a_pending->generation.load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		// never wait on the world while havok steps it, the chunk is tried again next frame rather than spinning on the lock
+		if (!a_rayCaster->TryLockWorld(a_build->world)) {
+			std::scoped_lock locker(a_pending->lock);
+			a_pending->deferred.push_back(std::move(a_build));
+			return;
+		}
+
+		CastSamples(a_rayCaster, a_build->world, *a_build, a_chunkSize);
+		a_rayCaster->UnlockWorld(a_build->world);
+
+		if (a_build->next < samplesPerTile) {
+			return SubmitChunk(a_rayCaster, std::move(a_pending), std::move(a_build), a_chunkSize);
+		}
+
+		a_build->world.reset();
+
+		std::scoped_lock locker(a_pending->lock);
+		a_pending->completed.push_back(std::move(*a_build));
+	}
+
+	void Manager::SubmitChunk(Engine::IRayCaster* a_rayCaster, std::shared_ptr<Pending> a_pending, std::shared_ptr<Build> a_build, std::size_t a_chunkSize)
+	{
+		Jobs::Pool::GetSingleton()->Submit([a_rayCaster, pending = std::move(a_pending), build = std::move(a_build), a_chunkSize]() mutable {
+			BuildChunk(a_rayCaster, std::move(pending), std::move(build), a_chunkSize);
+		});
+	}
+
+	const Tile* Manager::GetTile(Key a_key) const
+	{
+		if (const auto it = builtTiles.find(a_key); it != builtTiles.end()) {
+			return it->second.tile.get();
+		}
+		if (const auto it = mappedTiles.find(a_key); it != mappedTiles.end() && it->second.checked) {
+			return it->second.tile;
+		}
+		return nullptr;
+	}
+
+	bool Manager::GetSample(std::int32_t a_sampleX, std::int32_t a_sampleY, float& a_height, std::uint8_t& a_flags) const
+	{
+		static_assert(std::has_single_bit(static_cast<std::uint32_t>(samplesPerAxis)));
+		constexpr auto shift = std::countr_zero(static_cast<std::uint32_t>(samplesPerAxis));
+
+		// arithmetic shift floors negative coordinates too
+		const auto tile = GetTile(MakeKey(a_sampleX >> shift, a_sampleY >> shift));
+		if (!tile) {
+			return false;
+		}
+
+		const auto index = (a_sampleY & (samplesPerAxis - 1)) * samplesPerAxis + (a_sampleX & (samplesPerAxis - 1));
+		a_height = tile->heights[index];
+		a_flags = tile->flags[index];
+
+		return (a_flags & Tile::kValid) != 0;
+	}
+
+	std::optional<Sample> Manager::Get(float a_x, float a_y) const
+	{
+		if (!worldSpace) {
+			return std::nullopt;
+		}
+
+		lookups++;
+
+		if (Actors::Index::GetSingleton()->IsNear(a_x, a_y, actorMargin)) {
+			return std::nullopt;
+		}
+
+		// samples sit in the middle of their squares
+		const auto fx = a_x / sampleSpacing - 0.5f;
+		const auto fy = a_y / sampleSpacing - 0.5f;
+		const auto x0 = static_cast<std::int32_t>(std::floor(fx));
+		const auto y0 = static_cast<std::int32_t>(std::floor(fy));
+		const auto tx = fx - static_cast<float>(x0);
+		const auto ty = fy - static_cast<float>(y0);
+
+		std::array<float, 4>        heights{};
+		std::array<std::uint8_t, 4> flags{};
+		for (std::int32_t i = 0; i < 4; i++) {
+			if (!GetSample(x0 + (i & 1), y0 + (i >> 1), heights[i], flags[i])) {
+				return std::nullopt;
+			}
+		}
+
+		// roof edges, ledges and the like, interpolating across them would float splashes in mid-air
+		const auto [minHeight, maxHeight] = std::ranges::minmax(heights);
+		if (maxHeight - minHeight > maxSlope) {
+			return std::nullopt;
+		}
+
+		hits++;
+
+		const auto nearest = (ty < 0.5f ? 0 : 2) + (tx < 0.5f ? 0 : 1);
+		return Sample{
+			std::lerp(std::lerp(heights[0], heights[1], tx), std::lerp(heights[2], heights[3], tx), ty),
+			static_cast<Surface::TYPE>(flags[nearest] & ~Tile::kValid)
+		};
+	}
+
+	void Manager::Update(Engine::Cell* a_cell, const Engine::Point3& a_playerPos, std::uint32_t a_rayBudget)
+	{
+		std::vector<Build>                  finished;
+		std::vector<std::shared_ptr<Build>> deferred;
+		{
+			std::scoped_lock locker(pending->lock);
+			finished.swap(pending->completed);
+			deferred.swap(pending->deferred);
+		}
+		const auto generation = pending->generation.load(std::memory_order_relaxed);
+		for (auto& finishedBuild : finished) {
+			if (finishedBuild.generation == generation) {
+				Finish(finishedBuild);
+			}
+		}
+		for (auto& deferredBuild : deferred) {
+			if (deferredBuild->generation == generation) {
+				SubmitChunk(Engine::Get().rayCaster, pending, std::move(deferredBuild), std::max<std::size_t>(a_rayBudget, 1));
+			}
+		}
+
+		// interiors are left to havok, they are small and mods rearrange them far more often
+		auto currentWorldSpace = a_cell ? Engine::Get().rayCaster->GetWorldSpace(a_cell) : std::nullopt;
+		if ((currentWorldSpace ? currentWorldSpace->id : nullptr) != (worldSpace ? worldSpace->id : nullptr)) {
+			Load(std::move(currentWorldSpace));
+		}
+
+		if (!worldSpace) {
+			return;
+		}
+
+		UpdateBuild(a_cell, a_playerPos, a_rayBudget);
+	}
+
+	void Manager::UpdateBuild(Engine::Cell* a_cell, const Engine::Point3& a_playerPos, std::uint32_t a_rayBudget)
+	{
+		const auto rayCaster = Engine::Get().rayCaster;
+
+		if (build) {
+			// left before it finished, it starts over on the next visit
+			if (build->cell != a_cell) {
+				build.reset();
+			} else {
+				CastSamples(rayCaster, build->cell, *build, a_rayBudget);
+				if (build->next == samplesPerTile) {
+					Finish(*build);
+					build.reset();
+				}
+				return;
+			}
+		}
+
+		const auto cellX = detail::GetCellCoord(a_playerPos.x);
+		const auto cellY = detail::GetCellCoord(a_playerPos.y);
+		const auto key = MakeKey(cellX, cellY);
+
+		// taken on entry and every so often during the visit, scripts enable and disable references while the player is around
+		if (key != signedKey || ++signatureAge >= revalidateInterval) {
+			signedKey = key;
+			signature = rayCaster->GetCellSignature(a_cell);
+			signatureAge = 0;
+			if (!queued.contains(key)) {
+				Revalidate(key, signature);
+			}
+		}
+
+		if (queued.contains(key) || GetTile(key)) {
+			return;
+		}
+
+		// havok isn't set up until the cell is attached
+		auto world = rayCaster->AcquireWorld(a_cell);
+		if (!world) {
+			return;
+		}
+
+		Build newBuild{
+			key,
+			pending->generation.load(std::memory_order_relaxed),
+			a_cell,
+			std::move(world),
+			signature,
+			static_cast<float>(cellX) * cellSize,
+			static_cast<float>(cellY) * cellSize,
+			a_playerPos.z,
+			std::make_unique<Tile>()
+		};
+
+		if (const auto pool = Jobs::Pool::GetSingleton(); pool->IsRunning() && rayCaster->SupportsConcurrentQueries()) {
+			queued.insert(key);
+			pool->Submit([rayCaster, pending = pending, shared = std::make_shared<Build>(std::move(newBuild)), chunkSize = std::max<std::size_t>(a_rayBudget, 1)]() mutable {
+				BuildChunk(rayCaster, std::move(pending), std::move(shared), chunkSize);
+			});
+		} else {
+			newBuild.world.reset();
+			build = std::move(newBuild);
+		}
+	}
+
+	// a plugin added, removed or reordered, or a reference toggled, may have moved what's in the cell since the tile was built
+	void Manager::Revalidate(Key a_key, std::uint64_t a_signature)
+	{
+		const auto outOfDate = [&] {
+			logger::info("Exposure : tile {},{} is out of date, rebuilding", static_cast<std::int16_t>(a_key >> 16), static_cast<std::int16_t>(a_key & 0xFFFF));
+		};
+
+		if (const auto it = mappedTiles.find(a_key); it != mappedTiles.end()) {
+			if (it->second.signature == a_signature) {
+				it->second.checked = true;
+			} else {
+				outOfDate();
+				mappedTiles.erase(it);
+			}
+		}
+		if (const auto it = builtTiles.find(a_key); it != builtTiles.end() && it->second.signature != a_signature) {
+			outOfDate();
+			builtTiles.erase(it);
+		}
+	}
+
+	void Manager::CancelBuilds()
+	{
+		queued.clear();
+		pending->generation.fetch_add(1, std::memory_order_relaxed);
+
+		std::scoped_lock locker(pending->lock);
+		pending->deferred.clear();
+	}
+
+	void Manager::Finish(Build& a_build)
+	{
+		queued.erase(a_build.key);
+
+		const auto validCount = std::ranges::count_if(a_build.tile->flags, [](auto a_flags) { return (a_flags & Tile::kValid) != 0; });
+		logger::info("Exposure : built tile {},{} ({:.1f}% static)", static_cast<std::int16_t>(a_build.key >> 16), static_cast<std::int16_t>(a_build.key & 0xFFFF), 100.0f * static_cast<float>(validCount) / samplesPerTile);
+
+		builtTiles.insert_or_assign(a_build.key, BuiltTile{ std::move(a_build.tile), a_build.signature });
+		if (builtTiles.size() >= saveThreshold) {
+			Save();
+		}
+	}
+
+	void Manager::Load(std::optional<Engine::WorldSpace> a_worldSpace)
+	{
+		Save();
+
+		build.reset();
+		CancelBuilds();
+		signedKey.reset();
+
+		Unmap();
+		builtTiles.clear();
+
+		worldSpace = std::move(a_worldSpace);
+		path = worldSpace ? GetPath(*worldSpace) : std::filesystem::path{};
+		if (path.empty()) {
+			worldSpace.reset();
+			return;
+		}
+
+		Map();
+	}
+
+	void Manager::Map(const std::unordered_map<Key, std::uint64_t>& a_trusted)
+	{
+		auto mapped = std::make_unique<util::MappedFile>(path);
+		if (!mapped->IsOpen()) {
+			return;
+		}
+
+		const auto data = mapped->GetData();
+		const auto size = mapped->GetSize();
+
+		const auto header = reinterpret_cast<const detail::Header*>(data);
+		if (size < sizeof(detail::Header) || header->magic != magic || header->version != version || header->worldSpace != worldSpace->formID ||
+			header->samplesPerAxis != samplesPerAxis || header->cellSize != cellSize ||
+			size < sizeof(detail::Header) + header->tileCount * sizeof(detail::DirectoryEntry)) {
+			logger::info("Exposure : {} is outdated, rebuilding", path.filename().string());
+			return;
+		}
+
+		const auto directory = reinterpret_cast<const detail::DirectoryEntry*>(data + sizeof(detail::Header));
+		for (std::uint32_t i = 0; i < header->tileCount; i++) {
+			const auto& entry = directory[i];
+			if (entry.offset % alignof(Tile) != 0 || entry.offset + sizeof(Tile) > size) {
+				logger::info("Exposure : {} is truncated, rebuilding", path.filename().string());
+				mappedTiles.clear();
+				return;
+			}
+			const auto key = MakeKey(entry.x, entry.y);
+			const auto trusted = a_trusted.find(key);
+			mappedTiles.emplace(key, MappedTile{ reinterpret_cast<const Tile*>(data + entry.offset), entry.signature, trusted != a_trusted.end() && trusted->second == entry.signature });
+		}
+
+		file = std::move(mapped);
+
+		logger::info("Exposure : mapped {} tiles from {}", mappedTiles.size(), path.filename().string());
+	}
+
+	void Manager::Unmap()
+	{
+		mappedTiles.clear();
+		file.reset();
+	}
+
+	void Manager::Save()
+	{
+		if (builtTiles.empty() || path.empty()) {
+			return;
+		}
+
+		std::vector<std::pair<Key, MappedTile>> tiles(mappedTiles.begin(), mappedTiles.end());
+		for (const auto& [key, built] : builtTiles) {
+			if (!mappedTiles.contains(key)) {
+				tiles.emplace_back(key, MappedTile{ built.tile.get(), built.signature });
+			}
+		}
+
+		// tiles already checked this session, and the ones built in it, stay trusted once the file is mapped again
+		std::unordered_map<Key, std::uint64_t> trusted;
+		for (const auto& [key, tile] : tiles) {
+			if (tile.checked || builtTiles.contains(key)) {
+				trusted.emplace(key, tile.signature);
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		// the live file stays mapped while the new one is written next to it
+		auto tempPath = path;
+		tempPath += ".tmp";
+		{
+			std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+			if (!output) {
+				logger::warn("Exposure : failed to open {} for writing", tempPath.string());
+				return;
+			}
+
+			const detail::Header header{ magic, version, worldSpace->formID, samplesPerAxis, cellSize, static_cast<std::uint32_t>(tiles.size()) };
+			output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			auto offset = static_cast<std::uint32_t>(sizeof(detail::Header) + tiles.size() * sizeof(detail::DirectoryEntry));
+			for (const auto& [key, tile] : tiles) {
+				const detail::DirectoryEntry entry{ static_cast<std::int16_t>(key >> 16), static_cast<std::int16_t>(key & 0xFFFF), offset, tile.signature };
+				output.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+				offset += sizeof(Tile);
+			}
+
+			for (const auto& [key, tile] : tiles) {
+				output.write(reinterpret_cast<const char*>(tile.tile), sizeof(Tile));
+			}
+
+			if (!output) {
+				logger::warn("Exposure : failed to write {}", tempPath.string());
+				return;
+			}
+		}
+
+		Unmap();
+
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			logger::warn("Exposure : failed to replace {} ({})", path.string(), ec.message());
+			std::filesystem::remove(tempPath, ec);
+			Map(trusted);
+			return;
+		}
+
+		logger::info("Exposure : saved {} tiles ({} new) to {}", tiles.size(), builtTiles.size(), path.filename().string());
+
+		builtTiles.clear();
+		Map(trusted);
+	}
+}
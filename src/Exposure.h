@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Engine.h"
+#include "Surface.h"
+
+namespace util
+{
+	class MappedFile;
+}
+
+// coarse map of the highest static surface rain falls on, built the first time an exterior cell is visited and kept on disk per worldspace
+namespace Exposure
+{
+	inline constexpr std::uint32_t magic{ 0x58534F53 };
+	inline constexpr std::uint32_t version{ 2 };  // bump whenever sampling changes, older files are rebuilt
+
+	inline constexpr float        cellSize{ 4096.0f };
+	inline constexpr std::int32_t samplesPerAxis{ 64 };  // power of two
+	inline constexpr std::size_t  samplesPerTile{ samplesPerAxis * samplesPerAxis };
+	inline constexpr float        sampleSpacing{ cellSize / samplesPerAxis };
+
+	struct Sample
+	{
+		float         height{ 0.0f };
+		Surface::TYPE surface{ Surface::TYPE::kDefault };
+	};
+
+	// one exterior cell, written to disk as is
+	struct Tile
+	{
+		static constexpr std::uint8_t kValid{ 0x80 };  // top hit was static, low bits are the surface type
+
+		std::array<float, samplesPerTile>        heights{};
+		std::array<std::uint8_t, samplesPerTile> flags{};
+	};
+
+	class Manager : public ISingleton<Manager>
+	{
+	public:
+		Manager();
+		~Manager();
+
+		// once per frame on the main thread: follows the player's worldspace and builds the player's cell if it has no tile yet
+		// tiles are built on the job pool a_rayBudget rays per world lock, or that many rays per frame when the pool isn't running
+		void Update(Engine::Cell* a_cell, const Engine::Point3& a_playerPos, std::uint32_t a_rayBudget);
+
+		// interpolated static surface height, nullopt where unknown, not static, too uneven to interpolate or close to an actor
+		[[nodiscard]] std::optional<Sample> Get(float a_x, float a_y) const;
+
+		// writes built tiles to the worldspace file and maps it again, unsaved tiles are simply rebuilt next session
+		void Save();
+
+		// drops every build on the job pool, before the pool is stopped or resized; the player's cell is queued again next update
+		void CancelBuilds();
+
+		[[nodiscard]] std::size_t   GetTileCount() const { return mappedTiles.size() + builtTiles.size(); }
+		[[nodiscard]] std::size_t   GetBuiltTileCount() const { return builtTiles.size(); }
+		[[nodiscard]] std::uint64_t GetLookups() const { return lookups; }
+		[[nodiscard]] float         GetHitRate() const { return lookups > 0 ? static_cast<float>(hits) / static_cast<float>(lookups) : 0.0f; }
+
+	private:
+		using Key = std::uint32_t;  // packed cell coordinates
+
+		// tiles from disk are only trusted once the player's visit shows the cell's contents haven't changed
+		struct MappedTile
+		{
+			const Tile*   tile{ nullptr };  // view into the mapped file
+			std::uint64_t signature{ 0 };
+			bool          checked{ false };
+		};
+
+		struct BuiltTile
+		{
+			std::unique_ptr<Tile> tile;
+			std::uint64_t         signature{ 0 };
+		};
+
+		struct Build
+		{
+			Key                   key{ 0 };
+			std::uint32_t         generation{ 0 };
+			Engine::Cell*         cell{ nullptr };  // identity only, the job pool casts against the world
+			Engine::WorldRef      world;
+			std::uint64_t         signature{ 0 };
+			float                 originX{ 0.0f };
+			float                 originY{ 0.0f };
+			float                 z{ 0.0f };  // ray span is centered here
+			std::unique_ptr<Tile> tile;
+			std::size_t           next{ 0 };  // next sample to cast
+		};
+
+		// shared with the build jobs, which may still be running after a worldspace change
+		struct Pending
+		{
+			std::mutex                          lock;
+			std::vector<Build>                  completed;
+			std::vector<std::shared_ptr<Build>> deferred;  // the world was locked, tried again next frame
+			std::atomic<std::uint32_t> generation{ 0 };  // bumped on worldspace change, stale jobs stop at their next chunk
+		};
+
+		static constexpr std::size_t   saveThreshold{ 16 };        // unsaved tiles
+		static constexpr float         actorMargin{ 64.0f };       // samples this close to an actor's bound go through havok
+		static constexpr float         maxSlope{ 16.0f };          // height range across the interpolated samples
+		static constexpr std::uint32_t revalidateInterval{ 60 };  // updates between signature checks of the player's cell
+
+		static Key                   MakeKey(std::int32_t a_cellX, std::int32_t a_cellY);
+		static std::filesystem::path GetPath(const Engine::WorldSpace& a_worldSpace);
+
+		// by cell on the main thread, or by locked world on the job pool
+		template <class Target>
+		static void CastSamples(Engine::IRayCaster* a_rayCaster, const Target& a_target, Build& a_build, std::size_t a_count);
+		// casts one chunk, then queues the next one until the tile is done
+		static void BuildChunk(Engine::IRayCaster* a_rayCaster, std::shared_ptr<Pending> a_pending, std::shared_ptr<Build> a_build, std::size_t a_chunkSize);
+		static void SubmitChunk(Engine::IRayCaster* a_rayCaster, std::shared_ptr<Pending> a_pending, std::shared_ptr<Build> a_build, std::size_t a_chunkSize);
+
+		[[nodiscard]] const Tile* GetTile(Key a_key) const;
+		[[nodiscard]] bool        GetSample(std::int32_t a_sampleX, std::int32_t a_sampleY, float& a_height, std::uint8_t& a_flags) const;
+
+		void Load(std::optional<Engine::WorldSpace> a_worldSpace);
+		void Map(const std::unordered_map<Key, std::uint64_t>& a_trusted = {});  // tiles whose signature still matches start out checked
+		void Unmap();
+		void UpdateBuild(Engine::Cell* a_cell, const Engine::Point3& a_playerPos, std::uint32_t a_rayBudget);
+		void Revalidate(Key a_key, std::uint64_t a_signature);
+		void Finish(Build& a_build);
+
+		std::optional<Engine::WorldSpace> worldSpace;
+		std::filesystem::path             path;
+
+		std::unique_ptr<util::MappedFile>  file;
+		std::unordered_map<Key, MappedTile> mappedTiles;
+		std::unordered_map<Key, BuiltTile>  builtTiles;  // not on disk yet
+
+		std::optional<Build> build;  // casting on the main thread, a few rays per frame
+
+		std::shared_ptr<Pending> pending{ std::make_shared<Pending>() };  // built on the job pool
+		std::unordered_set<Key>  queued;
+
+		std::optional<Key> signedKey;  // cell the signature below was taken in
+		std::uint64_t      signature{ 0 };
+		std::uint32_t      signatureAge{ 0 };  // updates since
+
+		mutable std::uint64_t lookups{ 0 };
+		mutable std::uint64_t hits{ 0 };
+	};
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Engine.h"
+
+// conversions between the engine seam's plain types and the game's, only the game side of the plugin includes this
+namespace Engine
+{
+	static_assert(sizeof(Point3) == sizeof(RE::NiPoint3));
+
+	inline Point3 ToPoint(const RE::NiPoint3& a_point) { return { a_point.x, a_point.y, a_point.z }; }
+	inline RE::NiPoint3 ToNiPoint(const Point3& a_point) { return { a_point.x, a_point.y, a_point.z }; }
+
+	inline Cell* ToCell(RE::TESObjectCELL* a_cell) { return reinterpret_cast<Cell*>(a_cell); }
+	inline RE::TESObjectCELL* FromCell(Cell* a_cell) { return reinterpret_cast<RE::TESObjectCELL*>(a_cell); }
+}
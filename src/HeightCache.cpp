@@ -0,0 +1,80 @@
+#include "HeightCache.h"
+#include "Scheduler.h"
+
+namespace RayCast
+{
+	void HeightCache::SetParameters(float a_cellSize, float a_lifetime)
+	{
+		a_cellSize = std::max(a_cellSize, 1.0f);
+		if (cellSize != a_cellSize) {
+			cellSize = a_cellSize;
+			invCellSize = 1.0f / a_cellSize;
+			Clear();
+		}
+		lifetime = a_lifetime;
+	}
+
+	std::pair<std::int32_t, std::int32_t> HeightCache::GetCellCoords(const Engine::Point3& a_pos) const
+	{
+		return {
+			static_cast<std::int32_t>(std::floor(a_pos.x * invCellSize)),
+			static_cast<std::int32_t>(std::floor(a_pos.y * invCellSize))
+		};
+	}
+
+	HeightCache::Entry& HeightCache::GetSlot(std::int32_t a_x, std::int32_t a_y)
+	{
+		return entries[(a_y & (gridSize - 1)) * gridSize + (a_x & (gridSize - 1))];
+	}
+
+	void HeightCache::UpdateWorld(const void* a_world)
+	{
+		if (world != a_world) {
+			world = a_world;
+			Clear();
+		}
+	}
+
+	const HeightCache::Entry* HeightCache::Get(const void* a_world, const Engine::Point3& a_pos)
+	{
+		UpdateWorld(a_world);
+
+		lookups++;
+
+		const auto [x, y] = GetCellCoords(a_pos);
+		const auto& entry = GetSlot(x, y);
+		if (!entry.valid || entry.x != x || entry.y != y || FrameClock::GetSingleton()->Now() - entry.time > lifetime) {
+			return nullptr;
+		}
+
+		hits++;
+		return &entry;
+	}
+
+	void HeightCache::Store(const void* a_world, const Engine::Point3& a_pos, float a_height, Surface::TYPE a_surface, bool a_water)
+	{
+		UpdateWorld(a_world);
+
+		const auto [x, y] = GetCellCoords(a_pos);
+		GetSlot(x, y) = { x, y, a_height, FrameClock::GetSingleton()->Now(), a_surface, a_water, true };
+	}
+
+	void HeightCache::Invalidate(const Engine::Point3& a_pos)
+	{
+		const auto [x, y] = GetCellCoords(a_pos);
+		if (auto& entry = GetSlot(x, y); entry.x == x && entry.y == y) {
+			entry.valid = false;
+		}
+	}
+
+	void HeightCache::Clear()
+	{
+		entries.fill({});
+	}
+
+	void HeightCache::ResetCounters()
+	{
+		lookups = 0;
+		hits = 0;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Surface.h"
+
+namespace RayCast
+{
+	// temporal grid cache of rain surface hits around the player, so repeated rays over static geometry skip PickObject
+	class HeightCache : public ISingleton<HeightCache>
+	{
+	public:
+		struct Entry
+		{
+			std::int32_t  x{ 0 };
+			std::int32_t  y{ 0 };
+			float         height{ 0.0f };
+			float         time{ 0.0f };  // FrameClock seconds
+			Surface::TYPE surface{ Surface::TYPE::kDefault };
+			bool          water{ false };
+			bool          valid{ false };
+		};
+
+		static constexpr float actorMargin{ 64.0f };  // entries this close to an actor's bound are skipped, it may be standing on them
+
+		void SetParameters(float a_cellSize, float a_lifetime);
+
+		[[nodiscard]] const Entry* Get(const void* a_world, const Engine::Point3& a_pos);
+		void                       Store(const void* a_world, const Engine::Point3& a_pos, float a_height, Surface::TYPE a_surface, bool a_water);  // static hits only
+		void                       Invalidate(const Engine::Point3& a_pos);
+		void                       Clear();
+
+		[[nodiscard]] std::uint64_t GetLookups() const { return lookups; }
+		[[nodiscard]] std::uint64_t GetRaysSaved() const { return hits; }
+		[[nodiscard]] float         GetHitRate() const { return lookups > 0 ? static_cast<float>(hits) / static_cast<float>(lookups) : 0.0f; }
+		void                        ResetCounters();
+
+	private:
+		// 64x64 direct mapped slots, 2048 units across at the default cell size (the default splash disk diameter)
+		static constexpr std::int32_t gridSize{ 64 };
+
+		[[nodiscard]] std::pair<std::int32_t, std::int32_t> GetCellCoords(const Engine::Point3& a_pos) const;
+		[[nodiscard]] Entry&                                GetSlot(std::int32_t a_x, std::int32_t a_y);
+		void                                                UpdateWorld(const void* a_world);
+
+		std::array<Entry, gridSize * gridSize> entries{};
+		const void*                            world{ nullptr };  // physics world identity, see Engine::IRayCaster::GetWorld
+		float                                  cellSize{ 32.0f };
+		float                                  invCellSize{ 1.0f / 32.0f };
+		float                                  lifetime{ 3.0f };
+
+		std::uint64_t lookups{ 0 };
+		std::uint64_t hits{ 0 };
+	};
+}
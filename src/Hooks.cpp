@@ -1,9 +1,95 @@
 #include "Hooks.h"
+#include "ActorIndex.h"
+#include "Exposure.h"
+#include "Game.h"
+#include "Particles.h"
+#include "RayBatch.h"
+#include "Scheduler.h"
 #include "Settings.h"
+#include "Stats.h"
+#include "Surface.h"
+#include "Trace.h"
 #include "Util.h"
 
 namespace Ripples
 {
+	struct Static
+	{
+		// borrowed, the water objects own them; dropped as soon as any ripple object is added, removed or swapped
+		struct RippleObject
+		{
+			RE::NiAVObject*                          object;
+			std::vector<RE::BSEffectShaderMaterial*> materials;
+			std::vector<float>                       alphas;  // what was last written to each material, eased towards the game's
+		};
+
+		static inline std::vector<RippleObject> rippleObjects;
+		static inline std::size_t               cacheSignature = 0;
+
+		// the water index signature misses ripple objects swapped on a water object it already knows
+		static std::size_t GetSignature(RE::TESWaterSystem* a_waterSystem)
+		{
+			std::size_t seed = a_waterSystem->waterObjects.size();
+			for (const auto& waterObject : a_waterSystem->waterObjects) {
+				const auto rippleObject = waterObject ? waterObject->waterRippleObject.get() : nullptr;
+				seed ^= reinterpret_cast<std::size_t>(rippleObject) + 0x9E3779B97F4A7C15 + (seed << 6) + (seed >> 2);
+			}
+			return seed;
+		}
+
+		static void CacheMaterials(RE::TESWaterSystem* a_waterSystem)
+		{
+			rippleObjects.clear();
+
+			for (auto& waterObject : a_waterSystem->waterObjects) {
+				if (waterObject) {
+					if (const auto& rippleObject = waterObject->waterRippleObject; rippleObject) {
+						RippleObject cached{ rippleObject.get() };
+
+						RE::BSVisit::TraverseScenegraphGeometries(rippleObject.get(), [&](RE::BSGeometry* a_geometry) -> RE::BSVisit::BSVisitControl {
+							using State = RE::BSGeometry::States;
+
+							if (const auto effect = a_geometry->properties[State::kEffect].get()) {
+								if (const auto effectShaderProp = netimmerse_cast<RE::BSEffectShaderProperty*>(effect)) {
+									if (const auto material = static_cast<RE::BSEffectShaderMaterial*>(effectShaderProp->material)) {
+										cached.materials.push_back(material);
+										cached.alphas.push_back(material->baseColor.alpha);
+									}
+								}
+							}
+
+							return RE::BSVisit::BSVisitControl::kContinue;
+						});
+
+						rippleObjects.push_back(std::move(cached));
+					}
+				}
+			}
+		}
+
+		// owns the ripple alpha on every call: whatever the game's toggle just wrote is only the target, the materials ease towards it
+		// when the toggle didn't run the target is what was written last time, so the ripples hold instead of snapping
+		static void FadeWaterRipples(RE::TESWaterSystem* a_waterSystem)
+		{
+			// rebuilt before anything is touched, the cache never outlives the ripple objects it was taken from
+			if (const auto signature = GetSignature(a_waterSystem); signature != cacheSignature) {
+				cacheSignature = signature;
+				CacheMaterials(a_waterSystem);
+			}
+
+			const float maxStep = Settings::Manager::GetSingleton()->Get()->rippleFadeSpeed * RE::GetSecondsSinceLastFrame();
+
+			for (auto& rippleObject : rippleObjects) {
+				for (std::size_t i = 0; i < rippleObject.materials.size(); i++) {
+					auto&       alpha = rippleObject.alphas[i];
+					const float target = rippleObject.materials[i]->baseColor.alpha;
+					alpha += std::clamp(target - alpha, -maxStep, maxStep);
+					rippleObject.materials[i]->baseColor.alpha = alpha;
+				}
+			}
+		}
+	};
+
 	struct ToggleWaterSplashes
 	{
 		static void thunk(RE::TESWaterSystem* a_waterSystem, bool a_enabled, float a_fadeAmount)
@@ -12,15 +98,23 @@ namespace Ripples
 			const auto rain = settings->GetRain();
 
 			if (!rain) {
-				return func(a_waterSystem, false, 0.0f);
+				func(a_waterSystem, false, 0.0f);
+				return Static::FadeWaterRipples(a_waterSystem);
 			}
 
 			if (!rain->ripple.enabled) {
-				return func(a_waterSystem, a_enabled, a_fadeAmount);
+				func(a_waterSystem, a_enabled, a_fadeAmount);
+				return Static::FadeWaterRipples(a_waterSystem);
 			}
 
+			// dynamic ripples on top, the procedural ones hold where their fade left them
+			Static::FadeWaterRipples(a_waterSystem);
 			if (a_enabled && a_fadeAmount > 0.0f) {
-				Dynamic::ToggleWaterRipples(rain, a_waterSystem);
+				const Stats::ScopedTimer timer{ Stats::TIMER::kRippleHook };
+				const auto player = RE::PlayerCharacter::GetSingleton();
+				if (const auto cell = player->GetParentCell()) {
+					Dynamic::Emit(rain, Engine::ToCell(cell), Engine::ToPoint(player->GetPosition()), RE::GetSecondsSinceLastFrame());
+				}
 			}
 		}
 		static inline REL::Relocation<decltype(thunk)> func;
@@ -37,9 +131,6 @@ namespace Ripples
 
 namespace Splashes
 {
-	inline float splashTimer = 0.0f;
-	constexpr float splashDelay = 0.01f;
-
 	struct UpdateShaderGeometry
 	{
 		static void thunk(RE::BSGeometry* a_precipGeometry, RE::NiCamera* a_camera, float a_delta, float a_cubeSize, float a_particleDensity, float a_windSpeed, float a_windAngle)
@@ -48,6 +139,13 @@ namespace Splashes
 
 			const auto settings = Settings::Manager::GetSingleton();
 
+			// one precipitation update per frame, close the previous frame's counters before this one starts
+			Stats::Tracker::GetSingleton()->EndFrame(settings->GetRainType(), RE::GetSecondsSinceLastFrame());
+			settings->AdvanceFrame();
+			RayCast::FrameClock::GetSingleton()->Advance(RE::GetSecondsSinceLastFrame());
+			RayCast::Batch::GetSingleton()->Update();
+			const Stats::ScopedTimer timer{ Stats::TIMER::kSplashHook };
+
 			if (!a_precipGeometry || a_particleDensity < 1.0f) {
 				settings->SetRainType(Rain::TYPE::kNone);
 				return;
@@ -64,42 +162,42 @@ namespace Splashes
 
 			const auto rain = settings->GetRain(a_particleDensity);
 
-			if (!rain || !rain->splash.enabled) {
+			if (!rain) {
 				return;
 			}
 
-			splashTimer += RE::GetSecondsSinceLastFrame();
+			Particles::Pool::GetSingleton()->SetBudget(rain->splash.maxLive);
 
-			if (splashTimer > splashDelay) {
-				splashTimer = 0.0f;
+			const auto player = RE::PlayerCharacter::GetSingleton();
+			const auto cell = Engine::ToCell(player->GetParentCell());
+			if (!cell) {
+				return;
+			}
 
-				const auto player = RE::PlayerCharacter::GetSingleton();
-				const auto cell = player->GetParentCell();
-				if (!cell) {
-					return;
-				}
+			Surface::Cache::GetSingleton()->Update(cell);
 
-				const auto playerPos = player->GetPosition();
-
-				const auto enableDebugMarker = settings->enableDebugMarkerSplash;
-				const auto rayCastRadius = rain->splash.rayCastRadius;
-				const auto rayCastIterations = rain->splash.rayCastIterations;
-
-				for (std::size_t i = 0; i < rayCastIterations; i++) {
-					if (const auto rayOrigin = RayCast::GenerateRandomPointAroundPlayer(rayCastRadius, playerPos, true); rayOrigin) {
-						SKSE::GetTaskInterface()->AddTask([=] {
-							if (const auto rayCastOutput = RayCast::GenerateRayCast(cell, { *rayOrigin }); rayCastOutput && !rayCastOutput->hitWater) {
-								if (!enableDebugMarker) {
-									const auto& model = rayCastOutput->hitActor ? rain->splash.nifActor : rain->splash.nif;
-									const float scale = rayCastOutput->hitActor ? rain->splash.nifScaleActor : rain->splash.nifScale;
-									RE::BSTempEffectParticle::Spawn(cell, 1.6f, model.c_str(), rayCastOutput->normal, rayCastOutput->hitPos, scale, 7, nullptr);
-								} else {
-									RE::BSTempEffectParticle::Spawn(cell, 1.6f, "MarkerX.nif", rayCastOutput->normal, rayCastOutput->hitPos, 0.5f, 7, nullptr);
-								}
-							}
-						});
-					}
-				}
+			const auto playerPos = Engine::ToPoint(player->GetPosition());
+			const auto delta = RE::GetSecondsSinceLastFrame();
+
+			const auto snapshot = settings->Get();
+			if (snapshot->actorSplashes || snapshot->exposureMaps || snapshot->heightCache) {
+				Actors::Index::GetSingleton()->Update(Engine::Get().actors, playerPos);
+			}
+			if (snapshot->exposureMaps) {
+				Exposure::Manager::GetSingleton()->Update(cell, playerPos, snapshot->exposureRayBudget);
+			}
+
+			if (const auto recorder = Trace::Recorder::GetSingleton(); recorder->IsRecording()) {
+				recorder->RecordFrame(cell, a_particleDensity, delta, a_windSpeed, a_windAngle, playerPos);
+			}
+
+			if (!rain->splash.enabled) {
+				return;
+			}
+
+			Emit(rain, cell, playerPos, delta);
+			if (snapshot->actorSplashes) {
+				EmitActors(rain, cell, playerPos, delta);
 			}
 		}
 		static inline REL::Relocation<decltype(thunk)> func;
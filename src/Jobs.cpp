@@ -0,0 +1,128 @@
+#include "Jobs.h"
+
+namespace Jobs
+{
+	Pool::~Pool()
+	{
+		Stop();
+	}
+
+	void Pool::Start(std::uint32_t a_threads)
+	{
+		if (a_threads == 0) {
+			a_threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+		}
+
+		if (workers.size() == a_threads) {
+			return;
+		}
+		Stop();
+
+		workers.reserve(a_threads);
+		for (std::uint32_t i = 0; i < a_threads; i++) {
+			workers.push_back(std::make_unique<Worker>());
+		}
+		// only start once every deque exists, workers steal from all of them
+		for (std::size_t i = 0; i < workers.size(); i++) {
+			workers[i]->thread = std::jthread([this, i](std::stop_token a_token) {
+				Run(a_token, i);
+			});
+		}
+
+		logger::debug("Started {} raycast workers", workers.size());
+	}
+
+	void Pool::Stop()
+	{
+		if (workers.empty()) {
+			return;
+		}
+
+		for (const auto& worker : workers) {
+			worker->thread.request_stop();
+		}
+		{
+			std::scoped_lock locker(sleepLock);
+		}
+		wake.notify_all();
+
+		for (const auto& worker : workers) {
+			worker->thread.join();
+		}
+		workers.clear();
+	}
+
+	void Pool::Submit(Job a_job)
+	{
+		if (workers.empty()) {
+			return std::invoke(a_job);
+		}
+
+		auto& worker = *workers[next.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+		{
+			std::scoped_lock locker(worker.lock);
+			worker.jobs.push_back(std::move(a_job));
+		}
+		queued.fetch_add(1, std::memory_order_release);
+
+		// a worker between its empty check and its wait holds sleepLock, so this can't slip in unnoticed
+		{
+			std::scoped_lock locker(sleepLock);
+		}
+		wake.notify_one();
+	}
+
+	bool Pool::TryPop(std::size_t a_index, Job& a_job)
+	{
+		auto& worker = *workers[a_index];
+
+		std::scoped_lock locker(worker.lock);
+		if (worker.jobs.empty()) {
+			return false;
+		}
+		a_job = std::move(worker.jobs.back());
+		worker.jobs.pop_back();
+		return true;
+	}
+
+	bool Pool::TrySteal(std::size_t a_thief, Job& a_job)
+	{
+		for (std::size_t i = 1; i < workers.size(); i++) {
+			auto& victim = *workers[(a_thief + i) % workers.size()];
+
+			std::unique_lock locker(victim.lock, std::try_to_lock);
+			if (!locker || victim.jobs.empty()) {
+				continue;
+			}
+			a_job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+
+			steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	void Pool::Run(std::stop_token a_token, std::size_t a_index)
+	{
+		Job job;
+		while (true) {
+			if (TryPop(a_index, job) || TrySteal(a_index, job)) {
+				queued.fetch_sub(1, std::memory_order_relaxed);
+				std::invoke(job);
+				job = nullptr;
+				continue;
+			}
+
+			if (a_token.stop_requested()) {
+				if (queued.load(std::memory_order_acquire) == 0) {
+					return;
+				}
+				continue;  // a steal lost a try_lock race, go around again
+			}
+
+			std::unique_lock locker(sleepLock);
+			wake.wait(locker, a_token, [this] { return queued.load(std::memory_order_acquire) > 0; });
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+namespace Jobs
+{
+	// fixed set of worker threads, each with its own deque; idle workers steal the oldest jobs of busy ones
+	class Pool : public ISingleton<Pool>
+	{
+	public:
+		using Job = std::function<void()>;
+
+		~Pool();
+
+		// 0 = half the hardware threads
+		void Start(std::uint32_t a_threads);
+		// runs whatever is still queued before joining
+		void Stop();
+
+		[[nodiscard]] bool          IsRunning() const { return !workers.empty(); }
+		[[nodiscard]] std::size_t   GetWorkerCount() const { return workers.size(); }
+		[[nodiscard]] std::uint64_t GetSteals() const { return steals.load(std::memory_order_relaxed); }
+
+		void Submit(Job a_job);
+
+	private:
+		struct Worker
+		{
+			std::mutex      lock;
+			std::deque<Job> jobs;
+			std::jthread    thread;
+		};
+
+		bool TryPop(std::size_t a_index, Job& a_job);
+		bool TrySteal(std::size_t a_thief, Job& a_job);
+		void Run(std::stop_token a_token, std::size_t a_index);
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<std::size_t>             next{ 0 };
+		std::atomic<std::size_t>             queued{ 0 };
+		std::atomic<std::uint64_t>           steals{ 0 };
+
+		std::mutex                  sleepLock;
+		std::condition_variable_any wake;
+	};
+}
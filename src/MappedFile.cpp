@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace util
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::filesystem::path& a_path)
+	{
+		file = ::CreateFileW(a_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			file = nullptr;
+			return;
+		}
+
+		LARGE_INTEGER fileSize{};
+		if (!::GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			return;
+		}
+
+		mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			return;
+		}
+
+		view = static_cast<const std::byte*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (view) {
+			size = static_cast<std::size_t>(fileSize.QuadPart);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (view) {
+			::UnmapViewOfFile(view);
+		}
+		if (mapping) {
+			::CloseHandle(mapping);
+		}
+		if (file) {
+			::CloseHandle(file);
+		}
+	}
+#else
+	MappedFile::MappedFile(const std::filesystem::path& a_path)
+	{
+		file = ::open(a_path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return;
+		}
+
+		struct stat info{};
+		if (::fstat(file, &info) != 0 || info.st_size == 0) {
+			return;
+		}
+
+		if (const auto data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, file, 0); data != MAP_FAILED) {
+			view = static_cast<const std::byte*>(data);
+			size = static_cast<std::size_t>(info.st_size);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (view) {
+			::munmap(const_cast<std::byte*>(view), size);
+		}
+		if (file >= 0) {
+			::close(file);
+		}
+	}
+#endif
+}
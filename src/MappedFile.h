@@ -0,0 +1,29 @@
+#pragma once
+
+namespace util
+{
+	// read only view of a whole file, unmapped on destruction
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::filesystem::path& a_path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		[[nodiscard]] bool             IsOpen() const { return view != nullptr; }
+		[[nodiscard]] const std::byte* GetData() const { return view; }
+		[[nodiscard]] std::size_t      GetSize() const { return size; }
+
+	private:
+#ifdef _WIN32
+		void* file{ nullptr };
+		void* mapping{ nullptr };
+#else
+		int file{ -1 };
+#endif
+		const std::byte* view{ nullptr };
+		std::size_t      size{ 0 };
+	};
+}
@@ -6,10 +6,13 @@
 
 #include "toml++/toml.hpp"
 
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+
 #include <spdlog/sinks/basic_file_sink.h>
 
 #include "ClibUtil/string.hpp"
-#include "ClibUtil/rng.hpp"
 #include "ClibUtil/singleton.hpp"
 
 #define DLLEXPORT __declspec(dllexport)
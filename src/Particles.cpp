@@ -0,0 +1,202 @@
+#include "Particles.h"
+#include "Stats.h"
+
+namespace Particles
+{
+	void Pool::SetParameters(bool a_recycle, std::optional<float> a_recycleAge, bool a_budgetSkip)
+	{
+		recycle = a_recycle;
+		recycleAge = std::clamp(a_recycleAge.value_or(lifetime), 0.0f, lifetime);
+		budgetSkip = a_budgetSkip;
+	}
+
+	void Pool::SetBudget(std::uint32_t a_budget)
+	{
+		budget = std::clamp<std::size_t>(a_budget, 1, capacity);
+
+		// a lighter tier's lower cap applies right away, not only as new splashes push the old ones out
+		Expire();
+		while (size > budget) {
+			Evict();
+		}
+	}
+
+	void Pool::SetModels(std::vector<std::string> a_models)
+	{
+		std::ranges::sort(a_models);
+		const auto [first, last] = std::ranges::unique(a_models);
+		a_models.erase(first, last);
+
+		// a reload that leaves the models alone keeps the live effects and the loaded models
+		if (a_models == modelPaths) {
+			return;
+		}
+
+		// interned model pointers point into the old paths, move the live effects over to the new ones
+		const auto oldPaths = std::exchange(modelPaths, std::move(a_models));
+		for (std::size_t i = 0; i < size; i++) {
+			auto& instance = instances[(head + i) % capacity];
+			if (instance.model) {
+				instance.model = Intern(instance.model);
+			}
+		}
+
+		ResolveModels();
+	}
+
+	void Pool::ResolveModels()
+	{
+		models.clear();
+		for (const auto& path : modelPaths) {
+			RE::NiPointer<RE::NiNode> model;
+			if (const auto result = RE::BSModelDB::Demand(path.c_str(), model, RE::BSModelDB::DBTraits::ArgsType{}); result == RE::BSResource::ErrorCode::kNone && model) {
+				models.push_back(std::move(model));
+			} else {
+				logger::warn("Failed to load {}", path);
+			}
+		}
+
+		logger::info("Resolved {}/{} splash models", models.size(), modelPaths.size());
+	}
+
+	const char* Pool::Intern(const char* a_model) const
+	{
+		const auto it = std::ranges::lower_bound(modelPaths, std::string_view(a_model), {}, [](const std::string& a_path) { return std::string_view(a_path); });
+		return it != modelPaths.end() && *it == a_model ? it->c_str() : nullptr;
+	}
+
+	void Pool::Reset(RE::BSTempEffectParticle* a_effect, const RE::NiMatrix3& a_rotation, const RE::NiPoint3& a_position, float a_scale)
+	{
+		a_effect->age = 0.0f;
+		a_effect->rotation = a_rotation;
+		a_effect->position = a_position;
+		a_effect->scale = a_scale;
+
+		if (const auto& object = a_effect->particleObject) {
+			object->local.rotate = a_rotation;
+			object->local.translate = a_position;
+			object->local.scale = a_scale;
+
+			RE::BSVisit::TraverseScenegraphObjects(object.get(), [](RE::NiAVObject* a_object) -> RE::BSVisit::BSVisitControl {
+				for (auto controller = a_object->GetControllers(); controller; controller = controller->next.get()) {
+					controller->Start(0.0f);
+				}
+				return RE::BSVisit::BSVisitControl::kContinue;
+			});
+
+			RE::NiUpdateData updateData;
+			object->Update(updateData);
+		}
+	}
+
+	void Pool::Expire()
+	{
+		// drop expired effects, the effect list holds the other reference while an effect is alive
+		while (size > 0) {
+			if (const auto& effect = instances[head].effect; effect && effect->GetRefCount() > 1 && effect->age < effect->lifetime) {
+				break;
+			}
+			instances[head] = {};
+			head = (head + 1) % capacity;
+			size--;
+		}
+	}
+
+	bool Pool::TryRecycle(RE::TESObjectCELL* a_cell, const char* a_model, const RE::NiMatrix3& a_rotation, const RE::NiPoint3& a_position, float a_scale, bool a_force)
+	{
+		if ((!recycle && !a_force) || size == 0) {
+			return false;
+		}
+
+		const auto model = Intern(a_model);
+		if (!model) {
+			return false;
+		}
+
+		auto& oldest = instances[head];
+		const auto& effect = oldest.effect;
+
+		if ((effect->age < recycleAge && !a_force) || oldest.model != model || effect->cell != a_cell) {
+			return false;
+		}
+
+		Reset(effect.get(), a_rotation, a_position, a_scale);
+
+		// move to the back, it's now the youngest
+		auto instance = std::move(oldest);
+		head = (head + 1) % capacity;
+		instances[(head + size - 1) % capacity] = std::move(instance);
+
+		return true;
+	}
+
+	void Pool::Evict()
+	{
+		// aged out, the effect list drops it on its next update
+		if (const auto& effect = instances[head].effect) {
+			effect->age = effect->lifetime;
+			if (const auto& object = effect->particleObject) {
+				object->SetAppCulled(true);
+			}
+		}
+
+		instances[head] = {};
+		head = (head + 1) % capacity;
+		size--;
+
+		counters.evictions++;
+		Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kEvictions);
+	}
+
+	void Pool::Track(RE::BSTempEffectParticle* a_effect, const char* a_model)
+	{
+		if (!a_effect) {
+			return;
+		}
+
+		// the budget is clamped to capacity so Spawn has already made room, but never drop a live effect without releasing it
+		if (size == capacity) {
+			Evict();
+		}
+
+		instances[(head + size) % capacity] = { RE::NiPointer(a_effect), Intern(a_model) };
+		size++;
+	}
+
+	RE::BSTempEffectParticle* Pool::Spawn(RE::TESObjectCELL* a_cell, const char* a_model, const RE::NiMatrix3& a_rotation, const RE::NiPoint3& a_position, float a_scale)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		Expire();
+
+		const bool overBudget = size >= budget;
+		if (overBudget && budgetSkip) {
+			counters.skips++;
+			Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kBudgetSkips);
+			return nullptr;
+		}
+
+		RE::BSTempEffectParticle* effect = nullptr;
+		if (TryRecycle(a_cell, a_model, a_rotation, a_position, a_scale, overBudget)) {
+			effect = instances[(head + size - 1) % capacity].effect.get();
+			counters.recycles++;
+			if (overBudget) {
+				counters.evictions++;
+				Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kEvictions);
+			}
+		} else {
+			// the oldest can't be reused in place (other model or cell), free its slot instead
+			while (size >= budget) {
+				Evict();
+			}
+			effect = RE::BSTempEffectParticle::Spawn(a_cell, lifetime, a_model, a_rotation, a_position, a_scale, 7, nullptr);
+			Track(effect, a_model);
+			counters.allocations++;
+		}
+
+		counters.spawns++;
+		counters.spawnTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		return effect;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+namespace Particles
+{
+	inline constexpr float lifetime{ 1.6f };
+
+	// keeps splash models resident, recycles splash effects whose animation has finished and caps how many are alive at once
+	class Pool : public ISingleton<Pool>
+	{
+	public:
+		struct Counters
+		{
+			std::uint64_t spawns{ 0 };
+			std::uint64_t allocations{ 0 };
+			std::uint64_t recycles{ 0 };
+			std::uint64_t evictions{ 0 };  // oldest live effect reused or killed early to stay under the budget
+			std::uint64_t skips{ 0 };      // spawns dropped at the budget
+			std::uint64_t spawnTime{ 0 };  // nanoseconds
+
+			[[nodiscard]] float GetAverageLatency() const { return spawns > 0 ? static_cast<float>(spawnTime) / static_cast<float>(spawns) / 1000.0f : 0.0f; }  // microseconds
+		};
+
+		// effects are only reused once they've played out, unless a_recycleAge cuts them short
+		void SetParameters(bool a_recycle, std::optional<float> a_recycleAge, bool a_budgetSkip);
+		// loads the models up front so the first spawns of a new config don't demand them; main thread, from data loaded on
+		// live effects stay tracked, those whose model is no longer listed just can't be recycled
+		void SetModels(std::vector<std::string> a_models);
+
+		// one cap on all live splash effects, set every frame from the current tier's MaxLiveSplashes and clamped to capacity
+		// effects spawned under a heavier tier count against it too, the oldest are evicted as soon as it shrinks
+		void SetBudget(std::uint32_t a_budget);
+
+		[[nodiscard]] std::size_t GetLiveCount() const { return size; }
+		[[nodiscard]] std::size_t GetBudget() const { return budget; }
+
+		RE::BSTempEffectParticle* Spawn(RE::TESObjectCELL* a_cell, const char* a_model, const RE::NiMatrix3& a_rotation, const RE::NiPoint3& a_position, float a_scale);
+
+		[[nodiscard]] const Counters& GetCounters() const { return counters; }
+		void                          ResetCounters() { counters = {}; }
+
+	private:
+		struct Instance
+		{
+			RE::NiPointer<RE::BSTempEffectParticle> effect;
+			const char*                             model{ nullptr };  // interned, see Intern
+		};
+
+		void ResolveModels();
+
+		// pool owned copy of the path, settings snapshots each hold their own strings
+		[[nodiscard]] const char* Intern(const char* a_model) const;
+
+		void Expire();
+		bool TryRecycle(RE::TESObjectCELL* a_cell, const char* a_model, const RE::NiMatrix3& a_rotation, const RE::NiPoint3& a_position, float a_scale, bool a_force);
+		void Evict();
+		void Track(RE::BSTempEffectParticle* a_effect, const char* a_model);
+
+		static void Reset(RE::BSTempEffectParticle* a_effect, const RE::NiMatrix3& a_rotation, const RE::NiPoint3& a_position, float a_scale);
+
+		// effects share one lifetime, so spawn order is age order and only the oldest needs checking
+		// every effect is tracked, so this is also the hard cap on live splashes whatever the config says
+		static constexpr std::size_t capacity{ 512 };
+
+		std::array<Instance, capacity> instances{};
+		std::size_t                    head{ 0 };  // oldest
+		std::size_t                    size{ 0 };
+		std::size_t                    budget{ capacity };
+		bool                           budgetSkip{ false };
+
+		std::vector<std::string>               modelPaths;
+		std::vector<RE::NiPointer<RE::NiNode>> models;  // held so spawns by path are model cache hits
+		bool                                   recycle{ true };
+		float                                  recycleAge{ lifetime };
+		Counters                               counters{};
+	};
+}
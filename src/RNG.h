@@ -0,0 +1,87 @@
+#pragma once
+
+namespace util
+{
+	class RNG
+	{
+	public:
+		// independent streams, so adding draws to one consumer doesn't shift the sequence of the others
+		enum class STREAM : std::uint32_t
+		{
+			kSplash,
+			kRipple,
+			kRotation,
+
+			kTotal
+		};
+
+		static RNG* GetSingleton(STREAM a_stream = STREAM::kRotation)
+		{
+			static std::array<RNG, std::to_underlying(STREAM::kTotal)> streams{};
+			return &streams[std::to_underlying(a_stream)];
+		}
+
+		// 0 = seed from the clock; returns the seed used
+		static std::uint64_t Seed(std::uint64_t a_seed)
+		{
+			const auto seed = a_seed != 0 ? a_seed : static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+			for (std::uint32_t i = 0; i < std::to_underlying(STREAM::kTotal); i++) {
+				GetSingleton(static_cast<STREAM>(i))->Reset(seed + i * 0x9E3779B97F4A7C15);
+			}
+			return seed;
+		}
+
+		// [a_min, a_max), same sequence on every platform unlike the std distributions
+		float generate(float a_min, float a_max)
+		{
+			return a_min + generate() * (a_max - a_min);
+		}
+
+		// [0, 1) from the top 24 bits
+		float generate()
+		{
+			return static_cast<float>(next() >> 8) * 0x1.0p-24f;
+		}
+
+		RNG()
+		{
+			Reset(static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+		}
+
+		RNG(RNG const&) = delete;
+		RNG(RNG&&) = delete;
+		~RNG() = default;
+		RNG& operator=(RNG const&) = delete;
+		RNG& operator=(RNG&&) = delete;
+
+	private:
+		// xoshiro128+, state expanded from the seed with splitmix64
+		void Reset(std::uint64_t a_seed)
+		{
+			for (auto& word : state) {
+				a_seed += 0x9E3779B97F4A7C15;
+				auto z = a_seed;
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+				word = static_cast<std::uint32_t>(z ^ (z >> 31));
+			}
+		}
+
+		std::uint32_t next()
+		{
+			const auto result = state[0] + state[3];
+			const auto t = state[1] << 9;
+
+			state[2] ^= state[0];
+			state[3] ^= state[1];
+			state[1] ^= state[2];
+			state[0] ^= state[3];
+			state[2] ^= t;
+			state[3] = std::rotl(state[3], 11);
+
+			return result;
+		}
+
+		std::array<std::uint32_t, 4> state{};
+	};
+}
@@ -0,0 +1,346 @@
+#include "RayBatch.h"
+#include "Emitter.h"
+#include "Engine.h"
+#include "Jobs.h"
+#include "Scheduler.h"
+#include "Settings.h"
+#include "Stats.h"
+#include "Util.h"
+
+namespace RayCast
+{
+	namespace detail
+	{
+		// actor probes stop short of the head, so the actor's own capsule doesn't shelter it
+		constexpr float actorProbeHeight{ 512.0f };
+		constexpr float actorProbeClearance{ 16.0f };
+
+		bool IsProbe(Batch::TYPE a_type)
+		{
+			return a_type == Batch::TYPE::kRippleProbe || a_type == Batch::TYPE::kActorProbe;
+		}
+
+		Span GetProbeSpan(const Batch::Ray& a_ray, float a_rippleProbeHeight)
+		{
+			return a_ray.type == Batch::TYPE::kActorProbe ?
+			           GetShelterSpan(a_ray.origin, actorProbeHeight, actorProbeClearance) :
+			           GetShelterSpan(a_ray.origin, a_rippleProbeHeight);
+		}
+
+		// calls a_func with each flag turned into a template argument, in order, so every combination is its own instantiation
+		template <bool... FLAGS, class F>
+		void Dispatch(F&& a_func)
+		{
+			a_func.template operator()<FLAGS...>();
+		}
+
+		template <bool... FLAGS, class F, class... Rest>
+		void Dispatch(F&& a_func, bool a_flag, Rest... a_rest)
+		{
+			if (a_flag) {
+				Dispatch<FLAGS..., true>(std::forward<F>(a_func), a_rest...);
+			} else {
+				Dispatch<FLAGS..., false>(std::forward<F>(a_func), a_rest...);
+			}
+		}
+
+		// moves the ray into the loaded cell it falls in, false once that cell has unloaded
+		bool Rehome(Batch::Ray& a_ray)
+		{
+			const auto cell = GetLoadedCell(a_ray.cell, a_ray.origin);
+			if (!cell) {
+				Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kUnloadedRays);
+				return false;
+			}
+			if (cell != a_ray.cell) {
+				Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kCellTransfers);
+				a_ray.cell = cell;
+			}
+			return true;
+		}
+	}
+
+	void Batch::Add(TYPE a_type, Engine::Cell* a_cell, const Settings::RainHandle& a_rain, const Engine::Point3& a_origin, float a_scale)
+	{
+		// one task per ray, what the batch replaced
+		if (perRayTasks) {
+			Engine::Get().tasks->AddTask([this, ray = Ray{ a_type, a_cell, a_rain, a_origin, a_scale }] {
+				{
+					std::scoped_lock locker(lock);
+					pending.push_back(ray);
+				}
+				Drain();
+			});
+			return;
+		}
+
+		bool queueDrain = false;
+		{
+			std::scoped_lock locker(lock);
+			pending.push_back({ a_type, a_cell, a_rain, a_origin, a_scale });
+			if (!drainQueued) {
+				drainQueued = true;
+				queueDrain = true;
+			}
+		}
+
+		if (queueDrain) {
+			Engine::Get().tasks->AddTask([this] {
+				Drain();
+			});
+		}
+	}
+
+	void Batch::Update()
+	{
+		if (inFlight.load(std::memory_order_relaxed) > 0) {
+			QueueDrain();
+		}
+	}
+
+	void Batch::Flush()
+	{
+		// chunks are only returned by a drain, and a drain may send the queued rays out first
+		for (Drain(); inFlight.load(std::memory_order_relaxed) > 0; Drain()) {
+			std::this_thread::yield();
+		}
+	}
+
+	void Batch::QueueDrain()
+	{
+		{
+			std::scoped_lock locker(lock);
+			if (drainQueued) {
+				return;
+			}
+			drainQueued = true;
+		}
+
+		Engine::Get().tasks->AddTask([this] {
+			Drain();
+		});
+	}
+
+	Batch::Chunk* Batch::AcquireChunk()
+	{
+		if (freeChunks.empty()) {
+			chunks.push_back(std::make_unique<Chunk>());
+			chunks.back()->queries.reserve(chunkSize);
+			return chunks.back().get();
+		}
+
+		const auto chunk = freeChunks.back();
+		freeChunks.pop_back();
+		return chunk;
+	}
+
+	void Batch::Submit(Chunk* a_chunk, Engine::IRayCaster* a_rayCaster)
+	{
+		inFlight.fetch_add(1, std::memory_order_relaxed);
+		asyncQueries += a_chunk->queries.size();
+
+		Jobs::Pool::GetSingleton()->Submit([this, a_chunk, a_rayCaster] {
+			const auto start = Scheduler::clock::now();
+
+			// never wait on the world while it is stepped, the main thread picks the chunk up instead
+			if (const auto& world = a_chunk->queries.front().world; a_rayCaster->TryLockWorld(world)) {
+				for (auto& query : a_chunk->queries) {
+					query.hit = CastRaySpans(a_rayCaster, world, query.spans, query.fellBack);
+				}
+				a_rayCaster->UnlockWorld(world);
+			} else {
+				a_chunk->deferred = true;
+			}
+
+			a_chunk->cost = std::chrono::duration<float, std::milli>(Scheduler::clock::now() - start).count();
+
+			a_chunk->next = completed.load(std::memory_order_relaxed);
+			while (!completed.compare_exchange_weak(a_chunk->next, a_chunk, std::memory_order_release, std::memory_order_relaxed)) {}
+		});
+	}
+
+	template <class R, class O>
+	bool Batch::CollectCompleted(const EmitContext& a_context, const O& a_options)
+	{
+		const auto rayCaster = Engine::Get().rayCaster;
+		const auto scheduler = Scheduler::GetSingleton();
+
+		for (auto chunk = completed.exchange(nullptr, std::memory_order_acquire); chunk;) {
+			const auto next = chunk->next;
+
+			if (chunk->deferred) {
+				deferredChunks++;
+			}
+			scheduler->AddJobCost(chunk->cost);
+
+			for (auto& query : chunk->queries) {
+				// the player may have moved on since the query went out, the result is still good while its cell is loaded
+				if (!detail::Rehome(query.ray)) {
+					continue;
+				}
+
+				if (chunk->deferred) {
+					query.hit = CastRaySpans(rayCaster, query.ray.cell, query.spans, query.fellBack);
+				}
+
+				if (detail::IsProbe(query.ray.type)) {
+					if (!query.hit) {
+						R::EmitProbe(query.ray, a_context);
+					}
+					continue;
+				}
+
+				AddQueryStats(query.spans, query.fellBack, chunk->deferred);
+				if (const auto output = ResolveRayCast(a_options, query.world.get(), { query.ray.origin }, query.hit)) {
+					R::Emit(query.ray, *output, a_context);
+				}
+			}
+
+			chunk->queries.clear();
+			chunk->next = nullptr;
+			chunk->deferred = false;
+			chunk->cost = 0.0f;
+			freeChunks.push_back(chunk);
+			inFlight.fetch_sub(1, std::memory_order_relaxed);
+
+			chunk = next;
+		}
+
+		return inFlight.load(std::memory_order_relaxed) == 0;
+	}
+
+	void Batch::Drain()
+	{
+		const Stats::ScopedTimer timer{ Stats::TIMER::kDrain };
+
+		{
+			std::scoped_lock locker(lock);
+			draining.swap(pending);
+			drainQueued = false;
+		}
+
+		const auto& interfaces = Engine::Get();
+
+		if (const auto waterSystem = interfaces.waterSystem; waterSystem->IsEnabled()) {
+			Water::Index::GetSingleton()->Update(waterSystem);
+		}
+
+		const auto settings = Settings::Manager::GetSingleton()->Get();
+
+		const EmitContext context{ interfaces.camera->GetState() };
+
+		const auto scheduler = Scheduler::GetSingleton();
+		scheduler->Begin();
+
+		detail::Dispatch(
+			[&]<bool SPLASH_MARKER, bool RIPPLE_MARKER, bool SHARED_RAYS, bool HEIGHT_CACHE, bool EXPOSURE_MAPS>() {
+				using SplashPolicy = std::conditional_t<SPLASH_MARKER, Policies::DebugMarker<false>, Policies::Splash>;
+				using RipplePolicy = std::conditional_t<RIPPLE_MARKER, Policies::DebugMarker<true>, Policies::Ripple>;
+
+				const RayOptions<HEIGHT_CACHE, EXPOSURE_MAPS> options{ settings->raySpan };
+				Resolve<Router<SplashPolicy, RipplePolicy, SHARED_RAYS>>(context, options, *settings);
+			},
+			settings->enableDebugMarkerSplash, settings->enableDebugMarkerRipple, settings->sharedRays, settings->heightCache, settings->exposureMaps);
+
+		scheduler->End();
+
+		draining.clear();
+	}
+
+	template <class R, class O>
+	void Batch::Resolve(const EmitContext& a_context, const O& a_options, const Settings::Snapshot& a_settings)
+	{
+		// last frame's queries come back first; if the workers haven't caught up, this frame runs synchronously
+		const bool workersIdle = CollectCompleted<R>(a_context, a_options);
+
+		const bool async = a_settings.asyncRaycasts && Jobs::Pool::GetSingleton()->IsRunning() && Engine::Get().rayCaster->SupportsConcurrentQueries() && workersIdle;
+		if (a_settings.asyncRaycasts && !async && !draining.empty()) {
+			syncFallbacks++;
+		}
+
+		if (async) {
+			ResolveRays<R, O, true>(a_context, a_options, a_settings);
+		} else {
+			ResolveRays<R, O, false>(a_context, a_options, a_settings);
+		}
+	}
+
+	template <class R, class O, bool ASYNC>
+	void Batch::ResolveRays(const EmitContext& a_context, const O& a_options, const Settings::Snapshot& a_settings)
+	{
+		const auto probeHeight = a_settings.rippleShelterProbe;
+		const auto tracker = Stats::Tracker::GetSingleton();
+		const auto rayCaster = Engine::Get().rayCaster;
+
+		Chunk* chunk = nullptr;
+
+		// rays come in runs from the same cell, so the world is acquired once per run
+		Engine::Cell*    worldCell = nullptr;
+		Engine::WorldRef world;
+
+		for (auto& ray : draining) {
+			const bool probe = detail::IsProbe(ray.type);
+			if (probe) {
+				tracker->Add(ray.type == TYPE::kActorProbe ? Stats::COUNTER::kActorProbes : Stats::COUNTER::kShelterProbes);
+			}
+
+			if (!detail::Rehome(ray)) {
+				continue;
+			}
+
+			if constexpr (!ASYNC) {
+				if (probe) {
+					if (!IsSheltered(ray.cell, detail::GetProbeSpan(ray, probeHeight))) {
+						R::EmitProbe(ray, a_context);
+					}
+				} else if (const auto rayCastOutput = GenerateRayCast(a_options, ray.cell, { ray.origin }); rayCastOutput) {
+					R::Emit(ray, *rayCastOutput, a_context);
+				}
+			} else {
+				if (ray.cell != worldCell) {
+					worldCell = ray.cell;
+					world = rayCaster->AcquireWorld(ray.cell);
+				}
+				if (!world) {
+					// nothing to stop the rain, as IsSheltered
+					if (probe) {
+						R::EmitProbe(ray, a_context);
+					}
+					continue;
+				}
+
+				Query query{ ray, world, {}, std::nullopt, false };
+				if (probe) {
+					query.spans = { detail::GetProbeSpan(ray, probeHeight), std::nullopt };
+				} else {
+					if (const auto exposed = LookupExposure(a_options, { ray.origin })) {
+						R::Emit(ray, *exposed, a_context);
+						continue;
+					}
+					if (const auto cached = LookupRayCast(a_options, world.get(), { ray.origin })) {
+						R::Emit(ray, *cached, a_context);
+						continue;
+					}
+					query.spans = GetRaySpans(a_options, ray.cell, { ray.origin });
+				}
+
+				if (chunk && chunk->queries.front().world != world) {
+					Submit(std::exchange(chunk, nullptr), rayCaster);
+				}
+				if (!chunk) {
+					chunk = AcquireChunk();
+				}
+				chunk->queries.push_back(std::move(query));
+				if (chunk->queries.size() == chunkSize) {
+					Submit(std::exchange(chunk, nullptr), rayCaster);
+				}
+			}
+		}
+
+		if constexpr (ASYNC) {
+			if (chunk) {
+				Submit(chunk, rayCaster);
+			}
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Engine.h"
+#include "Settings.h"
+
+namespace RayCast
+{
+	struct EmitContext;
+
+	struct Span
+	{
+		[[nodiscard]] float GetLength() const { return from.GetDistance(to); }
+
+		Engine::Point3 from{};
+		Engine::Point3 to{};
+	};
+
+	// tight span cast first, the full span only if it missed
+	struct RaySpans
+	{
+		Span                primary;
+		std::optional<Span> fallback;
+	};
+
+	// collects every splash/ripple ray generated during a frame and drains them in a single task on the main thread
+	// in async mode the physics queries run on the job pool and their effects are spawned by the next frame's drain
+	class Batch : public ISingleton<Batch>
+	{
+	public:
+		enum class TYPE : std::uint8_t
+		{
+			kSplash,
+			kRipple,
+			kShared,       // splash or ripple depending on what it hits
+			kRippleProbe,  // origin is already on the water surface, only checked for shelter
+			kActorProbe    // origin is already on top of an actor, only checked for shelter
+		};
+
+		struct Ray
+		{
+			TYPE                 type{ TYPE::kSplash };
+			Engine::Cell*        cell{ nullptr };
+			Settings::RainHandle rain;
+			Engine::Point3       origin{};
+			float                scale{ 1.0f };  // multiplier on the tier's splash scale
+		};
+
+		void Add(TYPE a_type, Engine::Cell* a_cell, const Settings::RainHandle& a_rain, const Engine::Point3& a_origin, float a_scale = 1.0f);
+
+		// once per frame, makes sure results still out on the workers get collected even if no new rays are added
+		void Update();
+
+		// main thread: resolves every queued ray and waits for the workers, so nothing is left over when the interfaces are swapped
+		void Flush();
+
+		// headless benchmarks only: queues a drain task per ray, like the hooks did before the batch
+		void SetPerRayTasks(bool a_enabled) { perRayTasks = a_enabled; }
+
+		[[nodiscard]] std::uint64_t GetAsyncQueries() const { return asyncQueries; }
+		[[nodiscard]] std::uint64_t GetSyncFallbacks() const { return syncFallbacks; }
+		[[nodiscard]] std::uint64_t GetDeferredChunks() const { return deferredChunks; }
+
+	private:
+		struct Query
+		{
+			Ray                           ray;
+			Engine::WorldRef              world;  // resolved on the main thread, workers never touch the cell
+			RaySpans                      spans;
+			std::optional<Engine::RayHit> hit;
+			bool                          fellBack{ false };
+		};
+
+		// every query in a chunk shares one world, its read lock is held for the chunk and released between chunks
+		struct Chunk
+		{
+			std::vector<Query> queries;
+			Chunk*             next{ nullptr };
+			bool               deferred{ false };  // the world was being stepped, cast on the main thread when collected
+			float              cost{ 0.0f };       // milliseconds the worker spent on it, counted against the frame budget
+		};
+
+		static constexpr std::size_t chunkSize{ 32 };
+
+		void QueueDrain();
+		void Drain();
+
+		// specialized per Router (see Emitter.h) and RayOptions (see Util.h), Drain picks one instantiation per frame
+		template <class R, class O>
+		void Resolve(const EmitContext& a_context, const O& a_options, const Settings::Snapshot& a_settings);
+		template <class R, class O, bool ASYNC>
+		void ResolveRays(const EmitContext& a_context, const O& a_options, const Settings::Snapshot& a_settings);
+
+		Chunk* AcquireChunk();
+		void   Submit(Chunk* a_chunk, Engine::IRayCaster* a_rayCaster);
+		// resolves every chunk the workers finished, returns false if some are still running
+		template <class R, class O>
+		bool CollectCompleted(const EmitContext& a_context, const O& a_options);
+
+		std::mutex       lock;
+		std::vector<Ray> pending;
+		std::vector<Ray> draining;  // kept between frames so the capacity is reused
+		bool             drainQueued{ false };
+		bool             perRayTasks{ false };
+
+		std::atomic<Chunk*>                 completed{ nullptr };  // lock-free stack, pushed by workers
+		std::atomic<std::size_t>            inFlight{ 0 };
+		std::vector<std::unique_ptr<Chunk>> chunks;
+		std::vector<Chunk*>                 freeChunks;
+
+		std::uint64_t asyncQueries{ 0 };
+		std::uint64_t syncFallbacks{ 0 };
+		std::uint64_t deferredChunks{ 0 };
+	};
+}
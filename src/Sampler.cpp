@@ -0,0 +1,374 @@
+#include "Sampler.h"
+#include "Engine.h"
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define SAMPLER_AVX2
+#elif defined(_M_X64) || defined(__SSE2__)
+#	include <emmintrin.h>
+#	define SAMPLER_SSE2
+#endif
+
+namespace Sampler
+{
+	namespace detail
+	{
+		// R2 low discrepancy sequence, continued across frames so successive batches fill the gaps of earlier ones
+		struct R2Sequence
+		{
+			static constexpr float a1{ 0.7548776662f };
+			static constexpr float a2{ 0.5698402910f };
+
+			std::pair<float, float> next()
+			{
+				index++;
+				const auto n = static_cast<double>(index);
+				return {
+					static_cast<float>(std::fmod(0.5 + a1 * n, 1.0)),
+					static_cast<float>(std::fmod(0.5 + a2 * n, 1.0))
+				};
+			}
+
+			std::uint32_t index{ 0 };
+		};
+
+		inline R2Sequence r2;
+
+		// angular slack so splashes at the screen edges are not clipped
+		constexpr float fovMargin{ 0.1f };
+
+		// same margin NiCamera::PointInFrustum was called with
+		constexpr float frustumMargin{ 32.0f };
+
+		constexpr float invTwoPi{ 1.0f / Engine::TWO_PI };
+
+		// wrap to [-pi, pi], fold to [-pi/2, pi/2] using sin(x) = sin(pi - x), then a 7th order taylor polynomial (max error ~1.6e-4)
+		inline float sin_approx(float a_x)
+		{
+			float x = a_x - std::nearbyint(a_x * invTwoPi) * Engine::TWO_PI;
+			x = std::copysign(std::min(std::abs(x), Engine::PI - std::abs(x)), x);
+
+			const float x2 = x * x;
+			return x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f))));
+		}
+
+		inline void polar_to_cartesian(float a_u, float a_v, float& a_x, float& a_y, float a_originX, float a_originY, float a_radius, float a_thetaMin, float a_thetaRange)
+		{
+			const float theta = a_thetaMin + a_u * a_thetaRange;
+			const float r = a_radius * std::sqrt(a_v);
+
+			a_x = a_originX + r * sin_approx(theta + Engine::HALF_PI);
+			a_y = a_originY + r * sin_approx(theta);
+		}
+
+		// summed in the same order as the vector path, so both keep exactly the same points
+		inline bool in_frustum(float a_x, float a_y, float a_z, const FrustumPlanes& a_frustum, float a_margin)
+		{
+			for (const auto& [a, b, c, d] : a_frustum.planes) {
+				if ((a * a_x + b * a_y) + (c * a_z + d) < -a_margin) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		inline void polar_to_cartesian(PointBatch& a_batch, std::size_t a_begin, float a_originX, float a_originY, float a_radius, float a_thetaMin, float a_thetaRange)
+		{
+			for (auto i = a_begin; i < a_batch.size(); i++) {
+				polar_to_cartesian(a_batch.u[i], a_batch.v[i], a_batch.x[i], a_batch.y[i], a_originX, a_originY, a_radius, a_thetaMin, a_thetaRange);
+			}
+		}
+
+		inline std::size_t cull_to_frustum(PointBatch& a_batch, std::size_t a_begin, std::size_t a_kept, float a_z, const FrustumPlanes& a_frustum, float a_margin)
+		{
+			for (auto i = a_begin; i < a_batch.size(); i++) {
+				if (in_frustum(a_batch.x[i], a_batch.y[i], a_z, a_frustum, a_margin)) {
+					a_batch.x[a_kept] = a_batch.x[i];
+					a_batch.y[a_kept] = a_batch.y[i];
+					a_kept++;
+				}
+			}
+
+			a_batch.count = a_kept;
+			return a_kept;
+		}
+
+#if defined(SAMPLER_AVX2)
+		using vfloat = __m256;
+		constexpr std::size_t width{ 8 };
+
+		inline vfloat vset(float a_value) { return _mm256_set1_ps(a_value); }
+		inline vfloat vload(const float* a_ptr) { return _mm256_loadu_ps(a_ptr); }
+		inline void   vstore(float* a_ptr, vfloat a_value) { _mm256_storeu_ps(a_ptr, a_value); }
+		inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+		inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+		inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+		inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+		inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+		inline vfloat vand(vfloat a, vfloat b) { return _mm256_and_ps(a, b); }
+		inline vfloat vandnot(vfloat a, vfloat b) { return _mm256_andnot_ps(a, b); }
+		inline vfloat vor(vfloat a, vfloat b) { return _mm256_or_ps(a, b); }
+		inline vfloat vround(vfloat a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+		inline vfloat vcmpge(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		inline int    vmovemask(vfloat a) { return _mm256_movemask_ps(a); }
+#elif defined(SAMPLER_SSE2)
+		using vfloat = __m128;
+		constexpr std::size_t width{ 4 };
+
+		inline vfloat vset(float a_value) { return _mm_set1_ps(a_value); }
+		inline vfloat vload(const float* a_ptr) { return _mm_loadu_ps(a_ptr); }
+		inline void   vstore(float* a_ptr, vfloat a_value) { _mm_storeu_ps(a_ptr, a_value); }
+		inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+		inline vfloat vsub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+		inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+		inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+		inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a); }
+		inline vfloat vand(vfloat a, vfloat b) { return _mm_and_ps(a, b); }
+		inline vfloat vandnot(vfloat a, vfloat b) { return _mm_andnot_ps(a, b); }
+		inline vfloat vor(vfloat a, vfloat b) { return _mm_or_ps(a, b); }
+		inline vfloat vround(vfloat a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }  // round to nearest under the default MXCSR
+		inline vfloat vcmpge(vfloat a, vfloat b) { return _mm_cmpge_ps(a, b); }
+		inline int    vmovemask(vfloat a) { return _mm_movemask_ps(a); }
+#endif
+
+#if defined(SAMPLER_AVX2) || defined(SAMPLER_SSE2)
+		inline vfloat vsin_approx(vfloat a_x)
+		{
+			const vfloat signMask = vset(-0.0f);
+
+			vfloat x = vsub(a_x, vmul(vround(vmul(a_x, vset(invTwoPi))), vset(Engine::TWO_PI)));
+
+			const vfloat sign = vand(x, signMask);
+			const vfloat absX = vandnot(signMask, x);
+			x = vor(vmin(absX, vsub(vset(Engine::PI), absX)), sign);
+
+			const vfloat x2 = vmul(x, x);
+			vfloat poly = vadd(vset(1.0f / 120.0f), vmul(x2, vset(-1.0f / 5040.0f)));
+			poly = vadd(vset(-1.0f / 6.0f), vmul(x2, poly));
+			poly = vadd(vset(1.0f), vmul(x2, poly));
+			return vmul(x, poly);
+		}
+#endif
+	}
+
+	void PointBatch::resize(std::size_t a_count)
+	{
+		count = a_count;
+		if (u.size() < a_count) {
+			u.resize(a_count);
+			v.resize(a_count);
+			x.resize(a_count);
+			y.resize(a_count);
+		}
+	}
+
+	bool FrustumPlanes::Contains(const Engine::Point3& a_point, float a_radius) const
+	{
+		return std::ranges::all_of(planes, [&](const auto& a_plane) {
+			const auto& [a, b, c, d] = a_plane;
+			return a * a_point.x + b * a_point.y + c * a_point.z + d >= -a_radius;
+		});
+	}
+
+	std::optional<Sector> GetCameraSector(const Engine::Point3& a_playerPos, float a_radius)
+	{
+		const auto camera = Engine::Get().camera->GetState();
+		if (!camera) {
+			return std::nullopt;
+		}
+
+		const auto& forward = camera->forward;
+		if (forward.x == 0.0f && forward.y == 0.0f) {  // looking straight up/down, the whole disk may be visible
+			return Sector{ a_playerPos, 0.0f, Engine::PI };
+		}
+
+		// the samples are around the player, so the apex is too; seen from the player, a point r away is at most
+		// asin(offset / r) off the direction the camera sees it in, so the wedge is widened by that from half the radius out
+		const auto offset = std::hypot(camera->position.x - a_playerPos.x, camera->position.y - a_playerPos.y);
+		const auto widening = std::asin(std::min(offset / std::max(a_radius * 0.5f, 1.0f), 1.0f));
+
+		Sector sector;
+		sector.origin = a_playerPos;
+		sector.yaw = std::atan2(forward.y, forward.x);
+		sector.halfAngle = std::min(Engine::DegToRad(camera->fov) * 0.5f + detail::fovMargin + widening, Engine::PI);
+
+		return sector;
+	}
+
+	void ResetSequences()
+	{
+		detail::r2 = {};
+	}
+
+	void GenerateSamples(PointBatch& a_batch, std::uint32_t a_count, PATTERN a_pattern, util::RNG::STREAM a_stream)
+	{
+		a_batch.resize(a_count);
+		if (a_count == 0) {
+			return;
+		}
+
+		const auto rng = util::RNG::GetSingleton(a_stream);
+
+		// latin hypercube over (angle, radius): sample i takes radius stratum i and a shuffled angle stratum,
+		// so every one of the a_count strata on each axis gets exactly one sample whatever the count
+		if (a_pattern == PATTERN::kStratified) {
+			for (std::uint32_t i = 0; i < a_count; i++) {
+				const auto j = std::min(static_cast<std::uint32_t>(rng->generate() * static_cast<float>(i + 1)), i);
+				a_batch.u[i] = a_batch.u[j];
+				a_batch.u[j] = static_cast<float>(i);
+			}
+		}
+
+		const auto strata = static_cast<float>(a_count);
+
+		for (std::uint32_t i = 0; i < a_count; i++) {
+			switch (a_pattern) {
+			case PATTERN::kStratified:
+				a_batch.u[i] = (a_batch.u[i] + rng->generate()) / strata;
+				a_batch.v[i] = (static_cast<float>(i) + rng->generate()) / strata;
+				break;
+			case PATTERN::kBlueNoise:
+				std::tie(a_batch.u[i], a_batch.v[i]) = detail::r2.next();
+				break;
+			default:
+				a_batch.u[i] = rng->generate();
+				a_batch.v[i] = rng->generate();
+				break;
+			}
+		}
+	}
+
+	void PolarToCartesian(PointBatch& a_batch, float a_originX, float a_originY, float a_radius, float a_thetaMin, float a_thetaRange)
+	{
+		std::size_t i = 0;
+
+#if defined(SAMPLER_AVX2) || defined(SAMPLER_SSE2)
+		using namespace detail;
+
+		const vfloat originX = vset(a_originX);
+		const vfloat originY = vset(a_originY);
+		const vfloat radius = vset(a_radius);
+		const vfloat thetaMin = vset(a_thetaMin);
+		const vfloat thetaRange = vset(a_thetaRange);
+		const vfloat halfPi = vset(Engine::HALF_PI);
+
+		for (; i + width <= a_batch.size(); i += width) {
+			const vfloat theta = vadd(thetaMin, vmul(vload(&a_batch.u[i]), thetaRange));
+			const vfloat r = vmul(radius, vsqrt(vload(&a_batch.v[i])));
+
+			vstore(&a_batch.x[i], vadd(originX, vmul(r, vsin_approx(vadd(theta, halfPi)))));
+			vstore(&a_batch.y[i], vadd(originY, vmul(r, vsin_approx(theta))));
+		}
+#endif
+
+		detail::polar_to_cartesian(a_batch, i, a_originX, a_originY, a_radius, a_thetaMin, a_thetaRange);
+	}
+
+	void ApplyFalloff(PointBatch& a_batch, float a_falloff)
+	{
+		if (a_falloff <= 0.0f) {
+			return;
+		}
+
+		// radius cdf is t^(2 - falloff); PolarToCartesian takes sqrt(v), so pre-raise v to 2 / (2 - falloff)
+		const float exponent = 2.0f / (2.0f - a_falloff);
+		for (std::size_t i = 0; i < a_batch.size(); i++) {
+			a_batch.v[i] = std::pow(a_batch.v[i], exponent);
+		}
+	}
+
+	float GetScaleCompensation(float a_distance, float a_radius, float a_falloff, float a_limit)
+	{
+		if (a_falloff <= 0.0f || a_radius <= 0.0f) {
+			return 1.0f;
+		}
+
+		// uniform / falloff density at this distance, for the same number of samples over the disk
+		const float t = std::clamp(a_distance / a_radius, 0.0f, 1.0f);
+		const float densityRatio = std::pow(t, a_falloff) * 2.0f / (2.0f - a_falloff);
+
+		// splash area scales with the square of its scale
+		return std::clamp(std::sqrt(densityRatio), 1.0f, std::max(a_limit, 1.0f));
+	}
+
+	std::size_t CullToFrustum(PointBatch& a_batch, float a_z, const FrustumPlanes& a_frustum, float a_margin)
+	{
+		std::size_t kept = 0;
+		std::size_t i = 0;
+
+#if defined(SAMPLER_AVX2) || defined(SAMPLER_SSE2)
+		using namespace detail;
+
+		const vfloat margin = vset(-a_margin);
+
+		for (; i + width <= a_batch.size(); i += width) {
+			const vfloat x = vload(&a_batch.x[i]);
+			const vfloat y = vload(&a_batch.y[i]);
+
+			int mask = (1 << width) - 1;
+			for (const auto& [a, b, c, d] : a_frustum.planes) {
+				const vfloat distance = vadd(vadd(vmul(vset(a), x), vmul(vset(b), y)), vset(c * a_z + d));
+				mask &= vmovemask(vcmpge(distance, margin));
+			}
+
+			// compact in place, kept <= i so nothing unread is overwritten
+			for (std::size_t lane = 0; lane < width; lane++) {
+				if (mask & (1 << lane)) {
+					a_batch.x[kept] = a_batch.x[i + lane];
+					a_batch.y[kept] = a_batch.y[i + lane];
+					kept++;
+				}
+			}
+		}
+#endif
+
+		return detail::cull_to_frustum(a_batch, i, kept, a_z, a_frustum, a_margin);
+	}
+
+	namespace Scalar
+	{
+		void PolarToCartesian(PointBatch& a_batch, float a_originX, float a_originY, float a_radius, float a_thetaMin, float a_thetaRange)
+		{
+			detail::polar_to_cartesian(a_batch, 0, a_originX, a_originY, a_radius, a_thetaMin, a_thetaRange);
+		}
+
+		std::size_t CullToFrustum(PointBatch& a_batch, float a_z, const FrustumPlanes& a_frustum, float a_margin)
+		{
+			return detail::cull_to_frustum(a_batch, 0, 0, a_z, a_frustum, a_margin);
+		}
+	}
+
+	void GeneratePoints(const Sector& a_sector, float a_radius, std::uint32_t a_count, PATTERN a_pattern, float a_falloff, std::vector<Engine::Point3>& a_points)
+	{
+		static PointBatch batch;
+
+		GenerateSamples(batch, a_count, a_pattern, util::RNG::STREAM::kSplash);
+		ApplyFalloff(batch, a_falloff);
+		PolarToCartesian(batch, a_sector.origin.x, a_sector.origin.y, a_radius, a_sector.yaw - a_sector.halfAngle, 2.0f * a_sector.halfAngle);
+
+		a_points.clear();
+		for (std::size_t i = 0; i < batch.size(); i++) {
+			a_points.emplace_back(batch.x[i], batch.y[i], a_sector.origin.z);
+		}
+	}
+
+	void GenerateDiskPoints(const Engine::Point3& a_origin, float a_radius, std::uint32_t a_count, bool a_inPlayerFOV, float a_falloff, util::RNG::STREAM a_stream, std::vector<Engine::Point3>& a_points)
+	{
+		static PointBatch batch;
+
+		GenerateSamples(batch, a_count, PATTERN::kRandom, a_stream);
+		ApplyFalloff(batch, a_falloff);
+		PolarToCartesian(batch, a_origin.x, a_origin.y, a_radius, 0.0f, Engine::TWO_PI);
+
+		if (a_inPlayerFOV) {
+			if (const auto frustum = Engine::Get().camera->GetFrustum()) {
+				CullToFrustum(batch, a_origin.z, *frustum, detail::frustumMargin);
+			}
+		}
+
+		a_points.clear();
+		for (std::size_t i = 0; i < batch.size(); i++) {
+			a_points.emplace_back(batch.x[i], batch.y[i], a_origin.z);
+		}
+	}
+}
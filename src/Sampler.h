@@ -0,0 +1,79 @@
+#pragma once
+
+#include "RNG.h"
+#include "Types.h"
+
+namespace Sampler
+{
+	enum class PATTERN : std::uint32_t
+	{
+		kRandom,
+		kStratified,
+		kBlueNoise
+	};
+
+	// visible wedge of the disk around the player, apex at the camera
+	struct Sector
+	{
+		Engine::Point3 origin{};
+		float          yaw{ 0.0f };
+		float          halfAngle{ Engine::PI };
+	};
+
+	// structure of arrays, so the polar conversion and frustum test process 4/8 points per instruction
+	struct PointBatch
+	{
+		void resize(std::size_t a_count);
+
+		[[nodiscard]] std::size_t size() const { return count; }
+
+		std::vector<float> u;  // angle sample [0,1)
+		std::vector<float> v;  // radius sample [0,1)
+		std::vector<float> x;
+		std::vector<float> y;
+		std::size_t        count{ 0 };
+	};
+
+	struct FrustumPlanes
+	{
+		// sphere test, for the odd point that isn't worth a batch
+		[[nodiscard]] bool Contains(const Engine::Point3& a_point, float a_radius) const;
+
+		// normalized (a, b, c, d) world space planes, inside when ax + by + cz + d >= 0
+		std::array<std::array<float, 4>, 6> planes{};
+	};
+
+	// the view wedge around the player's disk of a_radius, null without a camera
+	std::optional<Sector> GetCameraSector(const Engine::Point3& a_playerPos, float a_radius);
+
+	// fills u/v with a_count samples of the given pattern
+	void GenerateSamples(PointBatch& a_batch, std::uint32_t a_count, PATTERN a_pattern, util::RNG::STREAM a_stream);
+
+	// restarts the low discrepancy sequences, for deterministic replays
+	void ResetSequences();
+
+	// x/y = origin + radius * sqrt(v) * (cos, sin)(thetaMin + u * thetaRange), using a vectorized sin/cos approximation
+	void PolarToCartesian(PointBatch& a_batch, float a_originX, float a_originY, float a_radius, float a_thetaMin, float a_thetaRange);
+
+	// reshapes radius samples so the area density falls off as (r / radius)^-falloff, 0 = uniform, must stay below 2
+	void ApplyFalloff(PointBatch& a_batch, float a_falloff);
+
+	// splash scale multiplier at a_distance, so the sparser far samples cover what uniform sampling would, clamped to [1, a_limit]
+	float GetScaleCompensation(float a_distance, float a_radius, float a_falloff, float a_limit);
+
+	// compacts the batch down to the points within a_margin of all six planes, returns the new size
+	std::size_t CullToFrustum(PointBatch& a_batch, float a_z, const FrustumPlanes& a_frustum, float a_margin);
+
+	// the same kernels without the vector path, for checking and timing it against
+	namespace Scalar
+	{
+		void        PolarToCartesian(PointBatch& a_batch, float a_originX, float a_originY, float a_radius, float a_thetaMin, float a_thetaRange);
+		std::size_t CullToFrustum(PointBatch& a_batch, float a_z, const FrustumPlanes& a_frustum, float a_margin);
+	}
+
+	// draws exactly a_count points inside the sector; no frustum rejection needed afterwards
+	void GeneratePoints(const Sector& a_sector, float a_radius, std::uint32_t a_count, PATTERN a_pattern, float a_falloff, std::vector<Engine::Point3>& a_points);
+
+	// draws a_count points over the whole disk, optionally keeping only those inside the camera frustum
+	void GenerateDiskPoints(const Engine::Point3& a_origin, float a_radius, std::uint32_t a_count, bool a_inPlayerFOV, float a_falloff, util::RNG::STREAM a_stream, std::vector<Engine::Point3>& a_points);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+namespace RayCast
+{
+	// scales raycast iteration counts each frame so the time spent draining the ray batch stays within a budget
+	// the clock is a template parameter so the controller can be driven by a simulated clock
+	template <class Clock>
+	class BudgetController
+	{
+	public:
+		using clock = Clock;
+
+		struct Parameters
+		{
+			float budget{ 0.0f };   // milliseconds per frame, 0 = disabled
+			float minScale{ 0.25f };
+			float maxScale{ 4.0f };
+			float smoothing{ 0.1f };  // EMA weight of the newest sample
+			float gain{ 0.25f };      // fraction of the relative error corrected per frame
+			float deadband{ 0.05f };  // relative error ignored to avoid hunting around the target
+		};
+
+		void SetParameters(const Parameters& a_params)
+		{
+			params = a_params;
+			scale = std::clamp(scale, params.minScale, params.maxScale);
+		}
+
+		[[nodiscard]] bool IsEnabled() const { return params.budget > 0.0f; }
+
+		void Begin()
+		{
+			start = Clock::now();
+		}
+
+		// work the drain handed to the job pool, added to the drain that collects it; main thread only
+		void AddJobCost(float a_cost)
+		{
+			jobCost += a_cost;
+		}
+
+		void End()
+		{
+			using ms = std::chrono::duration<float, std::milli>;
+			Update(std::chrono::duration_cast<ms>(Clock::now() - start).count() + std::exchange(jobCost, 0.0f));
+		}
+
+		void Update(float a_cost)
+		{
+			if (!IsEnabled()) {
+				return;
+			}
+
+			averageCost = hasSample ? averageCost + params.smoothing * (a_cost - averageCost) : a_cost;
+			hasSample = true;
+
+			// proportional control on the smoothed cost, applied multiplicatively since cost is ~linear in ray count
+			// free frames (nothing drained, timer resolution) still only step up, a burst of rays at maxScale would blow the budget
+			const float error = averageCost > 0.0f ? (params.budget - averageCost) / params.budget : 1.0f;
+			if (std::abs(error) > params.deadband) {
+				scale = std::clamp(scale * (1.0f + params.gain * std::clamp(error, -1.0f, 1.0f)), params.minScale, params.maxScale);
+			}
+		}
+
+		[[nodiscard]] float GetScale() const { return IsEnabled() ? scale : 1.0f; }
+		[[nodiscard]] float GetAverageCost() const { return averageCost; }
+
+		void Reset()
+		{
+			scale = 1.0f;
+			averageCost = 0.0f;
+			jobCost = 0.0f;
+			hasSample = false;
+		}
+
+	private:
+		Parameters                 params{};
+		typename Clock::time_point start{};
+		float                      scale{ 1.0f };
+		float                      averageCost{ 0.0f };
+		float                      jobCost{ 0.0f };
+		bool                       hasSample{ false };
+	};
+
+	// converts an emission rate into a per-frame ray count, carrying the fractional remainder to the next frame
+	class RateAccumulator
+	{
+	public:
+		std::uint32_t Update(float a_rate, float a_delta)
+		{
+			// clamp hitches (loading, menus) so they don't release a burst of rays
+			return Add(std::max(a_rate, 0.0f) * std::clamp(a_delta, 0.0f, maxDelta));
+		}
+
+		std::uint32_t Add(float a_amount)
+		{
+			remainder += a_amount;
+
+			const auto count = static_cast<std::uint32_t>(remainder);
+			remainder -= static_cast<float>(count);
+
+			return count;
+		}
+
+		void Reset() { remainder = 0.0f; }
+
+	private:
+		static constexpr float maxDelta{ 0.1f };
+
+		float remainder{ 0.0f };
+	};
+
+	class Scheduler :
+		public ISingleton<Scheduler>,
+		public BudgetController<std::chrono::steady_clock>
+	{
+	public:
+		// holds the scale at a recorded value, a replayed trace casts the rays the recording did whatever this machine's timing
+		void Pin(std::optional<float> a_scale) { pinned = a_scale; }
+
+		[[nodiscard]] float GetScale() const { return pinned ? *pinned : BudgetController::GetScale(); }
+
+	private:
+		std::optional<float> pinned;
+	};
+
+	// seconds of rain frames, advanced once per precipitation update; the caches expire on it instead of the wall clock,
+	// so a replayed trace expires entries on the same frames the recording did
+	class FrameClock : public ISingleton<FrameClock>
+	{
+	public:
+		void Advance(float a_delta) { time += std::max(a_delta, 0.0f); }
+		void Set(float a_time) { time = a_time; }
+
+		[[nodiscard]] float Now() const { return static_cast<float>(time); }
+
+	private:
+		double time{ 0.0 };  // summed in double, frame deltas would stop adding up in a float after a few hours
+	};
+}
@@ -1,83 +1,117 @@
 #include "Settings.h"
 
-void RainObject::LoadSettings(const toml::node_view<const toml::node>& a_node)
+const std::string& Splash::GetNif(Surface::TYPE a_surface) const
 {
-	get_value(enabled, a_node, "Enabled"sv);
-	get_value(rayCastRadius, a_node, "RaycastRadius"sv);
-	get_value(rayCastIterations, a_node, "RaycastIterations"sv);
+	const auto& surfaceNif = nifSurface[std::to_underlying(a_surface)];
+	return surfaceNif.empty() ? nif : surfaceNif;
 }
 
-void Splash::LoadSettings(const toml::node_view<const toml::node>& a_node)
+namespace Settings
 {
-	RainObject::LoadSettings(a_node);
+	DensityCurve::DensityCurve(std::vector<Point> a_points) :
+		points(std::move(a_points))
+	{
+		std::ranges::stable_sort(points, {}, &Point::first);
+	}
 
-	get_value(nif, a_node, "NifPath"sv);
-	get_value(nifActor, a_node, "NifPathActor"sv);
-	get_value(nifScale, a_node, "NifScale"sv);
-	get_value(nifScaleActor, a_node, "NifScaleActor"sv);
-}
+	DensityCurve DensityCurve::Step(float a_light, float a_medium, float a_heavy)
+	{
+		// repeated densities make the jump instantaneous
+		return DensityCurve({ { 0.0f, a_light }, { 5.0f, a_light }, { 5.0f, a_medium }, { 9.0f, a_medium }, { 9.0f, a_heavy } });
+	}
 
-void Ripple::LoadSettings(const toml::node_view<const toml::node>& a_node)
-{
-	RainObject::LoadSettings(a_node);
+	float DensityCurve::Evaluate(float a_density) const
+	{
+		if (points.empty()) {
+			return 0.0f;
+		}
 
-    get_value(rippleDisplacementAmount, a_node, "RippleDisplacementMult"sv);
-}
+		const auto upper = std::ranges::upper_bound(points, a_density, {}, &Point::first);
+		if (upper == points.begin()) {
+			return points.front().second;
+		}
+		if (upper == points.end()) {
+			return points.back().second;
+		}
 
-void Rain::LoadSettings(const toml::table& a_tbl, TYPE a_type, std::string_view a_section)
-{
-	type = a_type;
+		const auto& [x0, y0] = *std::prev(upper);
+		const auto& [x1, y1] = *upper;
 
-	splash.LoadSettings(a_tbl[a_section]);
-	ripple.LoadSettings(a_tbl[a_section]);
-}
+		return std::lerp(y0, y1, (a_density - x0) / (x1 - x0));
+	}
 
-namespace Settings
-{
-	bool Manager::LoadSettings()
+	Snapshot::Snapshot()
 	{
-		try {
-			toml::table tbl = toml::parse_file(fmt::format("Data/SKSE/Plugins/{}.toml", Version::PROJECT));
-
-			const auto& settings = tbl["Settings"];
-			enableDebugMarkerSplash = settings["DebugSplashes"].value_or(enableDebugMarkerSplash);
-			enableDebugMarkerRipple = settings["DebugRipples"].value_or(enableDebugMarkerRipple);
+		light.type = Rain::TYPE::kLight;
+		medium.type = Rain::TYPE::kMedium;
+		heavy.type = Rain::TYPE::kHeavy;
 
-			light.LoadSettings(tbl, Rain::TYPE::kLight, "LightRain");
-			medium.LoadSettings(tbl, Rain::TYPE::kMedium, "MediumRain");
-			heavy.LoadSettings(tbl, Rain::TYPE::kHeavy, "HeavyRain");
-
-		} catch (const toml::parse_error& e) {
-			std::ostringstream ss;
-			ss
-				<< "Error parsing file \'" << *e.source().path << "\':\n"
-				<< '\t' << e.description() << '\n'
-				<< "\t\t(" << e.source().begin << ')';
-			logger::error("{}", ss.str());
-
-			return false;
-		} catch (const std::exception& e) {
-			logger::error("{}", e.what());
+		Compile();
+	}
 
-			return false;
+	Rain::TYPE Snapshot::GetTier(float a_particleDensity)
+	{
+		if (a_particleDensity < 5.0f) {
+			return Rain::TYPE::kLight;
 		}
+		if (a_particleDensity < 9.0f) {
+			return Rain::TYPE::kMedium;
+		}
+		return Rain::TYPE::kHeavy;
+	}
 
-		logger::info("Success");
-
-		return true;
+	const Rain* Snapshot::GetRain(float a_particleDensity) const
+	{
+		// floored, rounding would hand densities just below a tier boundary the next tier's models and toggles
+		const auto index = static_cast<std::size_t>(std::clamp(a_particleDensity, 0.0f, maxDensity) * invDensityStep);
+		return &table[std::min(index, tableSize - 1)];
 	}
 
-	Rain* Manager::GetRain(float a_particleDensity)
+	void Snapshot::Compile(const CurveOverrides& a_overrides)
 	{
-		if (a_particleDensity < 5.0f) {
-			currentRainType = Rain::TYPE::kLight;
-		} else if (a_particleDensity >= 5.0f && a_particleDensity < 9.0f) {
-			currentRainType = Rain::TYPE::kMedium;
-		} else if (a_particleDensity >= 9.0f) {
-			currentRainType = Rain::TYPE::kHeavy;
+		const auto step = [this](auto&& a_value) {
+			return DensityCurve::Step(a_value(light), a_value(medium), a_value(heavy));
+		};
+
+		std::array<DensityCurve, std::to_underlying(CURVE::kTotal)> curves{
+			step([](const Rain& a_rain) { return a_rain.splash.rayCastRate; }),
+			step([](const Rain& a_rain) { return a_rain.splash.rayCastRadius; }),
+			step([](const Rain& a_rain) { return a_rain.splash.nifScale; }),
+			step([](const Rain& a_rain) { return a_rain.splash.nifScaleActor; }),
+			step([](const Rain& a_rain) { return a_rain.ripple.rayCastRate; }),
+			step([](const Rain& a_rain) { return a_rain.ripple.rayCastRadius; }),
+			step([](const Rain& a_rain) { return a_rain.ripple.rippleDisplacementAmount; })
+		};
+
+		for (std::size_t i = 0; i < curves.size(); i++) {
+			if (a_overrides[i]) {
+				curves[i] = *a_overrides[i];
+			}
+		}
+
+		const auto evaluate = [&](CURVE a_curve, float a_density) {
+			return curves[std::to_underlying(a_curve)].Evaluate(a_density);
+		};
+
+		table.clear();
+		table.reserve(tableSize);
+		for (std::size_t i = 0; i < tableSize; i++) {
+			const auto density = static_cast<float>(i) * densityStep;
+
+			auto& rain = table.emplace_back(*GetRain(GetTier(density)));
+			rain.splash.rayCastRate = evaluate(CURVE::kSplashRate, density);
+			rain.splash.rayCastRadius = evaluate(CURVE::kSplashRadius, density);
+			rain.splash.nifScale = evaluate(CURVE::kSplashScale, density);
+			rain.splash.nifScaleActor = evaluate(CURVE::kSplashScaleActor, density);
+			rain.ripple.rayCastRate = evaluate(CURVE::kRippleRate, density);
+			rain.ripple.rayCastRadius = evaluate(CURVE::kRippleRadius, density);
+			rain.ripple.rippleDisplacementAmount = evaluate(CURVE::kRippleDisplacement, density);
 		}
+	}
 
-		switch (currentRainType) {
+	const Rain* Snapshot::GetRain(Rain::TYPE a_type) const
+	{
+		switch (a_type) {
 		case Rain::TYPE::kLight:
 			return &light;
 		case Rain::TYPE::kMedium:
@@ -89,27 +123,83 @@ namespace Settings
 		}
 	}
 
-	Rain* Manager::GetRain()
+	Manager::Manager()
+	{
+		owner = std::make_shared<Snapshot>();
+		current.store(owner.get(), std::memory_order_release);
+	}
+
+	Manager::~Manager()
+	{
+		StopWatcher();
+	}
+
+	void Manager::Publish(std::shared_ptr<Snapshot> a_snapshot)
+	{
+		std::shared_ptr<const Snapshot> previous = std::exchange(owner, std::move(a_snapshot));
+		current.store(owner.get(), std::memory_order_release);
+
+		std::scoped_lock locker(retiredLock);
+		retired.push_back({ std::move(previous), frame });
+	}
+
+	void Manager::AdvanceFrame()
+	{
+		std::unique_lock locker(retiredLock, std::try_to_lock);
+		if (!locker) {
+			return;
+		}
+
+		frame++;
+
+		// raw Get() pointers don't outlive a frame, handles show up in use_count
+		std::erase_if(retired, [this](const Retired& a_retired) {
+			return frame > a_retired.frame + 2 && a_retired.snapshot.use_count() == 1;
+		});
+	}
+
+	void Manager::StopWatcher()
+	{
+		if (!watcher.joinable()) {
+			return;
+		}
+
+		watcher.request_stop();
+		watcherWake.notify_all();
+		watcher.join();
+		watcher = {};
+	}
+
+	Rain::TYPE Manager::GetRainType() const
 	{
-		switch (currentRainType) {
+		return currentRainType.load(std::memory_order_relaxed);
+	}
+
+	void Manager::SetRainType(Rain::TYPE a_type)
+	{
+		currentRainType.store(a_type, std::memory_order_relaxed);
+	}
+
+	RainHandle Manager::GetRain(float a_particleDensity)
+	{
+		currentDensity.store(a_particleDensity, std::memory_order_relaxed);
+		SetRainType(Snapshot::GetTier(a_particleDensity));
+
+		return GetRain();
+	}
+
+	RainHandle Manager::GetRain()
+	{
+		switch (GetRainType()) {
 		case Rain::TYPE::kLight:
-			return &light;
 		case Rain::TYPE::kMedium:
-			return &medium;
 		case Rain::TYPE::kHeavy:
-			return &heavy;
+			{
+				const auto snapshot = Get();
+				return { snapshot->shared_from_this(), snapshot->GetRain(currentDensity.load(std::memory_order_relaxed)) };
+			}
 		default:
 			return nullptr;
 		}
 	}
-
-    Rain::TYPE Manager::GetRainType() const
-    {
-		return currentRainType;
-    }
-
-    void Manager::SetRainType(Rain::TYPE a_type)
-	{
-		currentRainType = a_type;
-	}
 }
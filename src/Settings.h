@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Sampler.h"
+#include "Surface.h"
+
 class RainObject
 {
 public:
@@ -10,20 +13,18 @@ public:
 		type(std::move(a_type))
 	{}
 
-	virtual void LoadSettings(const toml::node_view<const toml::node>& a_node);
+	// config section key, see SettingsLoader.cpp
+	[[nodiscard]] const std::string& GetType() const { return type; }
 
 	bool enabled{ true };
 	float rayCastRadius{ 1024.0f };
-	std::uint32_t rayCastIterations{ 1 };
+	float rayCastRate{ 60.0f };  // rays per second
+
+	// old configs set a per-frame count, fired every frame (~60 fps)
+	static constexpr float legacyFrameRate{ 60.0f };
 
 protected:
 	std::string type;
-
-	template <class T>
-	void get_value(T& a_value, const toml::node_view<const toml::node>& a_node, std::string_view a_key)
-	{
-		a_value = a_node[type][a_key].value_or(a_value);
-	}
 };
 
 class Splash : public RainObject
@@ -34,12 +35,15 @@ public:
 	{}
 	~Splash() override = default;
 
-	void LoadSettings(const toml::node_view<const toml::node>& a_node) override;
+	[[nodiscard]] const std::string& GetNif(Surface::TYPE a_surface) const;
 
 	std::string nif{ "Effects\\rainSplashNoSpray.NIF" };
 	std::string nifActor{ "Effects\\rainSplashNoSpray.NIF" };
+	std::array<std::string, std::to_underlying(Surface::TYPE::kTotal)> nifSurface{};  // empty = nif
 	float nifScale{ 0.6f };
 	float nifScaleActor{ 0.2f };
+	float actorRate{ 4.0f };  // splashes per second per nearby actor, placed directly on them
+	std::uint32_t maxLive{ 256 };  // splash effects alive at once
 };
 
 class Ripple : public RainObject
@@ -48,12 +52,10 @@ public:
 	Ripple() :
 		RainObject("ripples")
 	{
-		rayCastIterations = 15;
+		rayCastRate = 900.0f;
 	}
 	~Ripple() override = default;
 
-	void LoadSettings(const toml::node_view<const toml::node>& a_node) override;
-
 	float rippleDisplacementAmount{ 0.4f };
 };
 
@@ -69,8 +71,6 @@ public:
 		kInvalid // Snow
 	};
 
-	void LoadSettings(const toml::table& a_tbl, TYPE a_type, std::string_view a_section);
-
 	TYPE type{ TYPE::kNone };
 	Splash splash;
 	Ripple ripple;
@@ -78,25 +78,173 @@ public:
 
 namespace Settings
 {
-	class Manager : public ISingleton<Manager>
+	enum class TRACE_MODE : std::uint32_t
+	{
+		kOff,
+		kRecord,
+		kReplay
+	};
+
+	enum class RAY_SPAN : std::uint32_t
+	{
+		kFull,      // 9999 units above and below
+		kAdaptive,  // cell height range only
+		kTwoPhase   // cell height range, full span on a miss
+	};
+
+	// piecewise linear function of precipitation particle density
+	class DensityCurve
 	{
 	public:
-		bool LoadSettings();
+		using Point = std::pair<float, float>;  // density, value
 
-		Rain* GetRain(float a_particleDensity);
-		Rain* GetRain();
+		DensityCurve() = default;
+		explicit DensityCurve(std::vector<Point> a_points);
 
-        [[nodiscard]] Rain::TYPE GetRainType() const;
-	    void SetRainType(Rain::TYPE a_type);
+		// holds each tier's value over its density range, same as the old per-tier buckets
+		static DensityCurve Step(float a_light, float a_medium, float a_heavy);
 
-		bool enableDebugMarkerSplash{ false };
-		bool enableDebugMarkerRipple{ false };
+		[[nodiscard]] float Evaluate(float a_density) const;
 
 	private:
+		std::vector<Point> points;
+	};
+
+	// everything read from the config, never modified once published
+	struct Snapshot : public std::enable_shared_from_this<Snapshot>
+	{
+		enum class CURVE : std::uint32_t
+		{
+			kSplashRate,
+			kSplashRadius,
+			kSplashScale,
+			kSplashScaleActor,
+			kRippleRate,
+			kRippleRadius,
+			kRippleDisplacement,
+
+			kTotal
+		};
+
+		static constexpr float       maxDensity{ 20.0f };
+		static constexpr float       densityStep{ 1.0f / 32.0f };           // curves are held flat at most this far, a few hundredths of their slope
+		static constexpr float       invDensityStep{ 1.0f / densityStep };  // exactly 32, so tier boundaries land on whole entries
+		static constexpr std::size_t tableSize{ static_cast<std::size_t>(maxDensity / densityStep) + 1 };
+
+		Snapshot();
+
+		[[nodiscard]] static Rain::TYPE GetTier(float a_particleDensity);
+
+		[[nodiscard]] const Rain* GetRain(Rain::TYPE a_type) const;
+		[[nodiscard]] const Rain* GetRain(float a_particleDensity) const;  // O(1) into the compiled table
+
+		// [[density, value], ...] curves from the config, replacing the matching tier values
+		using CurveOverrides = std::array<std::optional<DensityCurve>, std::to_underlying(CURVE::kTotal)>;
+
+		// samples the curves into the table, tiers still provide models and enabled flags
+		void Compile(const CurveOverrides& a_overrides = {});
+
 		Rain light;
 		Rain medium;
 		Rain heavy;
 
-		Rain::TYPE currentRainType{ Rain::TYPE::kNone };
+		std::vector<Rain> table;
+
+		bool enableDebugMarkerSplash{ false };
+		bool enableDebugMarkerRipple{ false };
+
+		bool             frustumSampling{ false };
+		Sampler::PATTERN samplingPattern{ Sampler::PATTERN::kStratified };
+		float            samplingFalloff{ 0.0f };
+		float            samplingScaleLimit{ 2.0f };
+
+		RAY_SPAN raySpan{ RAY_SPAN::kTwoPhase };
+
+		bool  heightCache{ false };
+		float heightCacheCellSize{ 32.0f };
+		float heightCacheLifetime{ 3.0f };
+
+		float frameBudget{ 0.0f };
+		float frameBudgetMinScale{ 0.25f };
+		float frameBudgetMaxScale{ 4.0f };
+
+		bool                 splashRecycling{ true };
+		std::optional<float> splashRecycleAge;           // the effect lifetime unless set
+		bool                 splashBudgetSkip{ false };  // at MaxLiveSplashes, drop new splashes instead of recycling the oldest
+
+		bool  rippleFastPath{ false };
+		float rippleShelterProbe{ 512.0f };
+		float rippleFadeSpeed{ 0.5f };  // procedural ripple alpha per second, towards what the game toggles them to
+
+		bool sharedRays{ false };  // with the fast path off
+
+		std::uint64_t seed{ 0 };  // 0 seeds from the clock, resolved value once applied
+		TRACE_MODE    traceMode{ TRACE_MODE::kOff };
+
+		bool          asyncRaycasts{ false };
+		std::uint32_t asyncThreads{ 2 };  // 0 = half the hardware threads
+
+		bool autoReload{ false };
+
+		bool actorSplashes{ false };  // off while recording or replaying traces
+
+		bool          exposureMaps{ false };    // off while recording or replaying traces, writes map files next to the plugin
+		std::uint32_t exposureRayBudget{ 64 };  // rays per world lock on the job pool, per frame if tiles are built on the main thread
+	};
+
+	// keeps the snapshot a tier belongs to alive, so queued work never sees a reload
+	using RainHandle = std::shared_ptr<const Rain>;
+
+	class Manager : public ISingleton<Manager>
+	{
+	public:
+		Manager();
+		~Manager();
+
+		// parses and applies the config, main thread only
+		bool LoadSettings();
+
+		// makes the snapshot current, the previous one is freed once nothing holds it; main thread only
+		void Publish(std::shared_ptr<Snapshot> a_snapshot);
+
+		// lock-free, the pointer stays valid for the rest of the frame
+		[[nodiscard]] const Snapshot* Get() const { return current.load(std::memory_order_acquire); }
+
+		RainHandle GetRain(float a_particleDensity);
+		RainHandle GetRain();
+
+		[[nodiscard]] Rain::TYPE GetRainType() const;
+		void                     SetRainType(Rain::TYPE a_type);
+
+		// once per frame, frees snapshots replaced a few frames ago that nothing holds anymore
+		void AdvanceFrame();
+
+	private:
+		struct Retired
+		{
+			std::shared_ptr<const Snapshot> snapshot;
+			std::uint64_t                   frame;
+		};
+
+		static std::shared_ptr<Snapshot> Parse();
+		void                             Apply(std::shared_ptr<Snapshot> a_snapshot);
+
+		void StartWatcher();
+		void StopWatcher();
+		void Watch(std::stop_token a_token);
+
+		std::atomic<const Snapshot*>    current{ nullptr };
+		std::shared_ptr<const Snapshot> owner;
+
+		std::mutex           retiredLock;
+		std::vector<Retired> retired;
+		std::uint64_t        frame{ 0 };
+
+		std::atomic<Rain::TYPE> currentRainType{ Rain::TYPE::kNone };
+		std::atomic<float>      currentDensity{ 0.0f };
+
+		std::jthread                watcher;
+		std::mutex                  watcherLock;
+		std::condition_variable_any watcherWake;
 	};
 }
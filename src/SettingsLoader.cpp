@@ -0,0 +1,313 @@
+#include "Settings.h"
+
+#include "Engine.h"
+#include "Exposure.h"
+#include "HeightCache.h"
+#include "Jobs.h"
+#include "Particles.h"
+#include "Scheduler.h"
+#include "Trace.h"
+
+// toml parsing and the game side of applying a snapshot, Settings.cpp holds the parts the headless target shares
+namespace Settings
+{
+	namespace detail
+	{
+		using Node = toml::node_view<const toml::node>;
+
+		std::string GetConfigPath()
+		{
+			return fmt::format("Data/SKSE/Plugins/{}.toml", Version::PROJECT);
+		}
+
+		template <class T>
+		void get_value(T& a_value, const Node& a_node, const RainObject& a_object, std::string_view a_key)
+		{
+			a_value = a_node[a_object.GetType()][a_key].value_or(a_value);
+		}
+
+		void LoadRainObject(RainObject& a_object, const Node& a_node)
+		{
+			get_value(a_object.enabled, a_node, a_object, "Enabled"sv);
+			get_value(a_object.rayCastRadius, a_node, a_object, "RaycastRadius"sv);
+			if (const auto rayCastIterations = a_node[a_object.GetType()]["RaycastIterations"sv].value<std::uint32_t>()) {
+				a_object.rayCastRate = static_cast<float>(*rayCastIterations) * RainObject::legacyFrameRate;
+			}
+			get_value(a_object.rayCastRate, a_node, a_object, "RaycastsPerSecond"sv);
+		}
+
+		void LoadSplash(Splash& a_splash, const Node& a_node)
+		{
+			LoadRainObject(a_splash, a_node);
+
+			get_value(a_splash.nif, a_node, a_splash, "NifPath"sv);
+			get_value(a_splash.nifActor, a_node, a_splash, "NifPathActor"sv);
+			get_value(a_splash.nifScale, a_node, a_splash, "NifScale"sv);
+			get_value(a_splash.nifScaleActor, a_node, a_splash, "NifScaleActor"sv);
+			get_value(a_splash.actorRate, a_node, a_splash, "ActorSplashesPerSecond"sv);
+			get_value(a_splash.maxLive, a_node, a_splash, "MaxLiveSplashes"sv);
+
+			constexpr std::array surfaceKeys{ ""sv, "NifPathStone"sv, "NifPathWood"sv, "NifPathMetal"sv, "NifPathFoliage"sv, "NifPathSnow"sv };
+			static_assert(surfaceKeys.size() == std::to_underlying(Surface::TYPE::kTotal));
+
+			for (std::size_t i = 1; i < surfaceKeys.size(); i++) {
+				get_value(a_splash.nifSurface[i], a_node, a_splash, surfaceKeys[i]);
+			}
+		}
+
+		void LoadRipple(Ripple& a_ripple, const Node& a_node)
+		{
+			LoadRainObject(a_ripple, a_node);
+
+			get_value(a_ripple.rippleDisplacementAmount, a_node, a_ripple, "RippleDisplacementMult"sv);
+		}
+
+		void LoadRain(Rain& a_rain, const toml::table& a_tbl, Rain::TYPE a_type, std::string_view a_section)
+		{
+			a_rain.type = a_type;
+
+			LoadSplash(a_rain.splash, a_tbl[a_section]);
+			LoadRipple(a_rain.ripple, a_tbl[a_section]);
+		}
+
+		// [[density, value], ...] arrays replace the matching tier values
+		Snapshot::CurveOverrides LoadCurves(const toml::table& a_tbl)
+		{
+			constexpr std::array curveKeys{
+				"SplashRaycastsPerSecond"sv,
+				"SplashRaycastRadius"sv,
+				"SplashNifScale"sv,
+				"SplashNifScaleActor"sv,
+				"RippleRaycastsPerSecond"sv,
+				"RippleRaycastRadius"sv,
+				"RippleDisplacementMult"sv
+			};
+			static_assert(curveKeys.size() == std::to_underlying(Snapshot::CURVE::kTotal));
+
+			Snapshot::CurveOverrides curves{};
+
+			if (const auto section = a_tbl["Curves"].as_table()) {
+				for (std::size_t i = 0; i < curveKeys.size(); i++) {
+					const auto array = (*section)[curveKeys[i]].as_array();
+					if (!array) {
+						continue;
+					}
+
+					std::vector<DensityCurve::Point> points;
+					for (const auto& node : *array) {
+						const auto point = node.as_array();
+						if (!point || point->size() != 2) {
+							logger::warn("Curves.{} : expected [density, value] pairs", curveKeys[i]);
+							continue;
+						}
+						points.emplace_back((*point)[0].value_or(0.0f), (*point)[1].value_or(0.0f));
+					}
+
+					if (!points.empty()) {
+						curves[i] = DensityCurve(std::move(points));
+					}
+				}
+			}
+
+			return curves;
+		}
+	}
+
+	std::shared_ptr<Snapshot> Manager::Parse()
+	{
+		auto snapshot = std::make_shared<Snapshot>();
+
+		try {
+			toml::table tbl = toml::parse_file(detail::GetConfigPath());
+
+			const auto& settings = tbl["Settings"];
+			snapshot->enableDebugMarkerSplash = settings["DebugSplashes"].value_or(snapshot->enableDebugMarkerSplash);
+			snapshot->enableDebugMarkerRipple = settings["DebugRipples"].value_or(snapshot->enableDebugMarkerRipple);
+
+			snapshot->frustumSampling = settings["FrustumSampling"].value_or(snapshot->frustumSampling);
+			snapshot->samplingPattern = static_cast<Sampler::PATTERN>(settings["SamplingPattern"].value_or(std::to_underlying(snapshot->samplingPattern)));
+			snapshot->samplingFalloff = std::clamp(settings["SamplingFalloff"].value_or(snapshot->samplingFalloff), 0.0f, 1.5f);
+			snapshot->samplingScaleLimit = settings["SamplingScaleLimit"].value_or(snapshot->samplingScaleLimit);
+
+			snapshot->raySpan = static_cast<RAY_SPAN>(std::min(settings["RaySpanMode"].value_or(std::to_underlying(snapshot->raySpan)), std::to_underlying(RAY_SPAN::kTwoPhase)));
+
+			snapshot->heightCache = settings["HeightCache"].value_or(snapshot->heightCache);
+			snapshot->heightCacheCellSize = settings["HeightCacheCellSize"].value_or(snapshot->heightCacheCellSize);
+			snapshot->heightCacheLifetime = settings["HeightCacheLifetime"].value_or(snapshot->heightCacheLifetime);
+
+			snapshot->frameBudget = settings["FrameBudget"].value_or(snapshot->frameBudget);
+			snapshot->frameBudgetMinScale = settings["FrameBudgetMinScale"].value_or(snapshot->frameBudgetMinScale);
+			snapshot->frameBudgetMaxScale = settings["FrameBudgetMaxScale"].value_or(snapshot->frameBudgetMaxScale);
+
+			detail::LoadRain(snapshot->light, tbl, Rain::TYPE::kLight, "LightRain");
+			detail::LoadRain(snapshot->medium, tbl, Rain::TYPE::kMedium, "MediumRain");
+			detail::LoadRain(snapshot->heavy, tbl, Rain::TYPE::kHeavy, "HeavyRain");
+			snapshot->Compile(detail::LoadCurves(tbl));
+
+			snapshot->rippleFastPath = settings["RippleFastPath"].value_or(snapshot->rippleFastPath);
+			snapshot->rippleShelterProbe = settings["RippleShelterProbe"].value_or(snapshot->rippleShelterProbe);
+			snapshot->rippleFadeSpeed = settings["RippleFadeSpeed"].value_or(snapshot->rippleFadeSpeed);
+
+			snapshot->sharedRays = settings["SharedRaycasts"].value_or(snapshot->sharedRays);
+
+			snapshot->splashRecycling = settings["SplashRecycling"].value_or(snapshot->splashRecycling);
+			if (const auto recycleAge = settings["SplashRecycleAge"].value<float>()) {
+				snapshot->splashRecycleAge = *recycleAge;
+			}
+			snapshot->splashBudgetSkip = settings["SplashBudgetSkip"].value_or(snapshot->splashBudgetSkip);
+
+			snapshot->seed = static_cast<std::uint64_t>(settings["Seed"].value_or<std::int64_t>(0));
+			snapshot->traceMode = static_cast<TRACE_MODE>(settings["TraceMode"].value_or(std::to_underlying(snapshot->traceMode)));
+
+			snapshot->asyncRaycasts = settings["AsyncRaycasts"].value_or(snapshot->asyncRaycasts);
+			snapshot->asyncThreads = settings["AsyncThreads"].value_or(snapshot->asyncThreads);
+
+			snapshot->autoReload = settings["AutoReload"].value_or(snapshot->autoReload);
+
+			snapshot->actorSplashes = settings["ActorSplashes"].value_or(snapshot->actorSplashes) && snapshot->traceMode == TRACE_MODE::kOff;
+
+			snapshot->exposureMaps = settings["ExposureMaps"].value_or(snapshot->exposureMaps) && snapshot->traceMode == TRACE_MODE::kOff;
+			snapshot->exposureRayBudget = settings["ExposureRayBudget"].value_or(snapshot->exposureRayBudget);
+
+		} catch (const toml::parse_error& e) {
+			std::ostringstream ss;
+			ss
+				<< "Error parsing file \'" << *e.source().path << "\':\n"
+				<< '\t' << e.description() << '\n'
+				<< "\t\t(" << e.source().begin << ')';
+			logger::error("{}", ss.str());
+
+			return nullptr;
+		} catch (const std::exception& e) {
+			logger::error("{}", e.what());
+
+			return nullptr;
+		}
+
+		return snapshot;
+	}
+
+	void Manager::Apply(std::shared_ptr<Snapshot> a_snapshot)
+	{
+		RayCast::HeightCache::GetSingleton()->SetParameters(a_snapshot->heightCacheCellSize, a_snapshot->heightCacheLifetime);
+
+		const auto scheduler = RayCast::Scheduler::GetSingleton();
+		scheduler->SetParameters({ .budget = a_snapshot->frameBudget, .minScale = a_snapshot->frameBudgetMinScale, .maxScale = std::max(a_snapshot->frameBudgetMinScale, a_snapshot->frameBudgetMaxScale) });
+		scheduler->Reset();
+
+		const auto pool = Particles::Pool::GetSingleton();
+		pool->SetParameters(a_snapshot->splashRecycling, a_snapshot->splashRecycleAge, a_snapshot->splashBudgetSkip);
+		std::vector<std::string> models{ Engine::IParticleSpawner::debugMarker };
+		for (const auto& rain : { &a_snapshot->light, &a_snapshot->medium, &a_snapshot->heavy }) {
+			models.push_back(rain->splash.nif);
+			models.push_back(rain->splash.nifActor);
+			for (const auto& nif : rain->splash.nifSurface) {
+				if (!nif.empty()) {
+					models.push_back(nif);
+				}
+			}
+		}
+		pool->SetModels(std::move(models));
+
+		// a reload mid recording keeps the trace and the streams going, reseeding would desync it from the seed in its header
+		const auto previous = Get();
+		const bool traceModeChanged = a_snapshot->traceMode != previous->traceMode;
+		if (a_snapshot->traceMode == TRACE_MODE::kRecord && !traceModeChanged) {
+			a_snapshot->seed = previous->seed;
+		} else {
+			a_snapshot->seed = util::RNG::Seed(a_snapshot->seed);
+		}
+
+		if (traceModeChanged) {
+			const auto recorder = Trace::Recorder::GetSingleton();
+			recorder->Stop();
+			if (a_snapshot->traceMode == TRACE_MODE::kRecord) {
+				recorder->Start(Trace::GetDefaultPath(), a_snapshot->seed);
+			}
+		}
+
+		// exposure builds resubmit themselves chunk by chunk, stopping the pool under them would drain them to the end
+		Exposure::Manager::GetSingleton()->CancelBuilds();
+
+		// exposure maps are built in the background even with raycasts kept on the main thread
+		if (a_snapshot->asyncRaycasts || a_snapshot->exposureMaps) {
+			Jobs::Pool::GetSingleton()->Start(a_snapshot->asyncRaycasts ? a_snapshot->asyncThreads : 1);
+		} else {
+			Jobs::Pool::GetSingleton()->Stop();
+		}
+
+		if (a_snapshot->autoReload) {
+			StartWatcher();
+		} else if (watcher.joinable() && !watcher.get_stop_token().stop_requested()) {
+			// this can be the watcher's own reload, only ask it to stop here and join it from a later main thread task
+			watcher.request_stop();
+			watcherWake.notify_all();
+			SKSE::GetTaskInterface()->AddTask([this] {
+				if (watcher.joinable() && watcher.get_stop_token().stop_requested()) {
+					StopWatcher();
+				}
+			});
+		}
+
+		Publish(std::move(a_snapshot));
+	}
+
+	bool Manager::LoadSettings()
+	{
+		auto snapshot = Parse();
+		if (!snapshot) {
+			return false;
+		}
+
+		Apply(std::move(snapshot));
+
+		logger::info("Success");
+
+		return true;
+	}
+
+	void Manager::StartWatcher()
+	{
+		if (watcher.joinable()) {
+			if (!watcher.get_stop_token().stop_requested()) {
+				return;
+			}
+			// turned back on before the stopping watcher was joined, it is already on its way out
+			StopWatcher();
+		}
+
+		watcher = std::jthread([this](std::stop_token a_token) {
+			Watch(a_token);
+		});
+
+		logger::info("Watching {} for changes", detail::GetConfigPath());
+	}
+
+	void Manager::Watch(std::stop_token a_token)
+	{
+		constexpr auto pollInterval = std::chrono::seconds(1);
+
+		const std::filesystem::path path = detail::GetConfigPath();
+
+		std::error_code ec;
+		auto lastWriteTime = std::filesystem::last_write_time(path, ec);
+
+		std::unique_lock locker(watcherLock);
+		while (!watcherWake.wait_for(locker, a_token, pollInterval, [] { return false; }) && !a_token.stop_requested()) {
+			const auto writeTime = std::filesystem::last_write_time(path, ec);
+			if (ec || writeTime == lastWriteTime) {
+				continue;
+			}
+			lastWriteTime = writeTime;
+
+			// parse off the main thread, only the swap and the parameter pushes run as a task
+			logger::info("{} changed, reloading settings..", path.string());
+			if (auto snapshot = Parse()) {
+				SKSE::GetTaskInterface()->AddTask([this, snapshot = std::move(snapshot)]() mutable {
+					Apply(std::move(snapshot));
+					logger::info("Success");
+				});
+			}
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#include "SpanCache.h"
+#include "Scheduler.h"
+
+namespace RayCast
+{
+	std::optional<Engine::HeightRange> SpanCache::Get(Engine::Cell* a_cell)
+	{
+		const auto now = FrameClock::GetSingleton()->Now();
+
+		auto entry = std::ranges::find(entries, a_cell, &Entry::cell);
+		if (entry == entries.end()) {
+			entry = std::ranges::min_element(entries, {}, &Entry::time);
+		} else if (now - entry->time <= lifetime) {
+			return entry->range;
+		}
+
+		entry->cell = a_cell;
+		entry->range = Engine::Get().rayCaster->GetHeightRange(a_cell);
+		entry->time = now;
+
+		return entry->range;
+	}
+
+	void SpanCache::Clear()
+	{
+		entries.fill({});
+	}
+}
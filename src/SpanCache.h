@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Engine.h"
+
+namespace RayCast
+{
+	// vertical extent of each loaded cell's collision, so rays only cross the slice of the world they can hit
+	class SpanCache : public ISingleton<SpanCache>
+	{
+	public:
+		[[nodiscard]] std::optional<Engine::HeightRange> Get(Engine::Cell* a_cell);
+
+		void Clear();
+
+	private:
+		struct Entry
+		{
+			Engine::Cell*                      cell{ nullptr };
+			std::optional<Engine::HeightRange> range;
+			float                              time{ 0.0f };  // FrameClock seconds
+		};
+
+		// references load in over a few frames after a cell attaches, and some move
+		static constexpr float lifetime{ 5.0f };
+
+		// rays near the player land in the 3x3 cells around them, the oldest entry makes room for a new cell
+		std::array<Entry, 9> entries;
+	};
+}
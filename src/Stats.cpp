@@ -0,0 +1,170 @@
+#include "Stats.h"
+
+namespace Stats
+{
+	namespace detail
+	{
+		constexpr std::array counterNames{
+			"splash_rays"sv,
+			"ripple_rays"sv,
+			"shared_rays"sv,
+			"shelter_probes"sv,
+			"actor_probes"sv,
+			"frustum_rejects"sv,
+			"cell_transfers"sv,
+			"unloaded_rays"sv,
+			"cache_hits"sv,
+			"surface_lookups"sv,
+			"surface_cache_hits"sv,
+			"exposure_hits"sv,
+			"actor_hits"sv,
+			"water_hits"sv,
+			"surface_hits"sv,
+			"misses"sv,
+			"ray_queries"sv,
+			"sync_ray_queries"sv,
+			"ray_fallbacks"sv,
+			"ray_length"sv,
+			"splashes"sv,
+			"ripples"sv,
+			"evictions"sv,
+			"budget_skips"sv
+		};
+		static_assert(counterNames.size() == std::to_underlying(COUNTER::kTotal));
+
+		constexpr std::array timerNames{
+			"splash_hook_ms"sv,
+			"ripple_hook_ms"sv,
+			"drain_ms"sv,
+			"raycast_ms"sv,
+			"ray_query_ms"sv
+		};
+		static_assert(timerNames.size() == std::to_underlying(TIMER::kTotal));
+
+		float Percentile(const std::vector<float>& a_sorted, float a_percentile)
+		{
+			if (a_sorted.empty()) {
+				return 0.0f;
+			}
+			const auto rank = static_cast<std::size_t>(std::ceil(a_percentile * static_cast<float>(a_sorted.size())));
+			return a_sorted[std::clamp<std::size_t>(rank, 1, a_sorted.size()) - 1];
+		}
+	}
+
+	void Tracker::EndFrame(Rain::TYPE a_tier, float a_delta)
+	{
+		current.tier = a_tier;
+		current.delta = a_delta;
+
+		frames[next] = current;
+		next = (next + 1) % capacity;
+		size = std::min(size + 1, capacity);
+		total++;
+
+		current = {};
+	}
+
+	Report Tracker::GetReport() const
+	{
+		Report report;
+		report.frames = static_cast<std::uint32_t>(size);
+
+		std::vector<float> costs;
+		costs.reserve(size);
+
+		for (std::size_t i = 0; i < size; i++) {
+			const auto& frame = frames[i];
+			costs.push_back(frame.GetCost());
+
+			auto& tier = report.tiers[std::to_underlying(frame.tier)];
+			tier.frames++;
+			tier.time += frame.delta;
+			tier.coverage += frame.coverage;
+			for (std::size_t j = 0; j < frame.counters.size(); j++) {
+				tier.counters[j] += frame.counters[j];
+			}
+			for (std::size_t j = 0; j < frame.time.size(); j++) {
+				tier.timers[j] += frame.time[j];
+			}
+		}
+
+		std::ranges::sort(costs);
+		report.p50 = detail::Percentile(costs, 0.50f);
+		report.p95 = detail::Percentile(costs, 0.95f);
+		report.p99 = detail::Percentile(costs, 0.99f);
+		report.max = costs.empty() ? 0.0f : costs.back();
+
+		return report;
+	}
+
+	bool Tracker::DumpCSV(const std::filesystem::path& a_path) const
+	{
+		std::ofstream file(a_path, std::ios::trunc);
+		if (!file.is_open()) {
+			logger::error("Failed to open {} for writing", a_path.string());
+			return false;
+		}
+
+		file << "frame,tier,delta,cost_ms,coverage";
+		for (const auto& name : detail::timerNames) {
+			file << ',' << name;
+		}
+		for (const auto& name : detail::counterNames) {
+			file << ',' << name;
+		}
+		file << '\n';
+
+		// oldest first
+		const auto start = size < capacity ? 0 : next;
+		for (std::size_t i = 0; i < size; i++) {
+			const auto& frame = frames[(start + i) % capacity];
+
+			file << fmt::format("{},{},{:.5f},{:.4f},{:.6f}", total - size + i, std::to_underlying(frame.tier), frame.delta, frame.GetCost(), frame.coverage);
+			for (const auto& time : frame.time) {
+				file << fmt::format(",{:.4f}", time);
+			}
+			for (const auto& counter : frame.counters) {
+				file << ',' << counter;
+			}
+			file << '\n';
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	void Tracker::Reset()
+	{
+		current = {};
+		next = 0;
+		size = 0;
+		total = 0;
+	}
+
+	float GetScreenCoverage(const Engine::CameraState& a_camera, const Engine::Point3& a_position, float a_scale)
+	{
+		// rough world radius of the splash nifs at scale 1, only meaningful as a relative measure
+		constexpr float splashRadius{ 16.0f };
+
+		const auto offset = a_position - a_camera.position;
+		const float depth = offset.Dot(a_camera.forward);
+		if (depth <= 1.0f || a_camera.fov <= 0.0f) {
+			return 0.0f;
+		}
+
+		const float halfWidth = depth * std::tan(Engine::DegToRad(a_camera.fov) * 0.5f);
+		const float projected = a_scale * splashRadius / halfWidth;  // radius in half screen widths
+
+		return std::min(Engine::PI * projected * projected / 4.0f, 1.0f);
+	}
+
+	std::filesystem::path GetDefaultCSVPath()
+	{
+		auto path = logger::log_directory();
+		if (!path) {
+			return {};
+		}
+
+		*path /= fmt::format("{}_stats.csv", Version::PROJECT);
+		return *path;
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "Engine.h"
+#include "Settings.h"
+
+// per-frame counters and timers for the splash/ripple pipeline, kept for the last few hundred frames
+namespace Stats
+{
+	enum class COUNTER : std::uint32_t
+	{
+		kSplashRays,
+		kRippleRays,
+		kSharedRays,  // counted in both kSplashRays and kRippleRays, cast once
+		kShelterProbes,
+		kActorProbes,
+		kFrustumRejects,
+		kCellTransfers,  // rays resolved into a loaded cell other than the one they were queued in
+		kUnloadedRays,   // rays dropped because the cell they fall in unloaded before they resolved
+		kCacheHits,
+		kSurfaceLookups,  // surface cache, havok material per hit sub-shape
+		kSurfaceCacheHits,
+		kExposureHits,
+		kActorHits,
+		kWaterHits,
+		kSurfaceHits,
+		kMisses,
+		kRayQueries,      // havok queries for full splash/ripple rays, both phases
+		kSyncRayQueries,  // the part of kRayQueries timed by kRayQuery
+		kRayFallbacks,    // full span casts after a tight span missed
+		kRayLength,       // summed length of kRayQueries, units
+		kSplashes,
+		kRipples,
+		kEvictions,
+		kBudgetSkips,
+
+		kTotal
+	};
+
+	enum class TIMER : std::uint32_t
+	{
+		kSplashHook,
+		kRippleHook,
+		kDrain,
+		kRayCast,   // nested in kDrain
+		kRayQuery,  // nested in kRayCast, havok only
+
+		kTotal
+	};
+
+	struct Frame
+	{
+		[[nodiscard]] std::uint32_t Get(COUNTER a_counter) const { return counters[std::to_underlying(a_counter)]; }
+		[[nodiscard]] float         Get(TIMER a_timer) const { return time[std::to_underlying(a_timer)]; }
+
+		// milliseconds spent in the hooks and the ray batch
+		[[nodiscard]] float GetCost() const { return Get(TIMER::kSplashHook) + Get(TIMER::kRippleHook) + Get(TIMER::kDrain); }
+
+		std::array<std::uint32_t, std::to_underlying(COUNTER::kTotal)> counters{};
+		std::array<float, std::to_underlying(TIMER::kTotal)>           time{};  // milliseconds
+		float                                                          coverage{ 0.0f };  // summed GetScreenCoverage of spawned splashes
+		float                                                          delta{ 0.0f };
+		Rain::TYPE                                                     tier{ Rain::TYPE::kNone };
+	};
+
+	struct Report
+	{
+		struct Tier
+		{
+			std::uint32_t frames{ 0 };
+			float         time{ 0.0f };  // seconds covered
+			double        coverage{ 0.0 };
+			std::array<std::uint64_t, std::to_underlying(COUNTER::kTotal)> counters{};
+			std::array<double, std::to_underlying(TIMER::kTotal)>          timers{};  // milliseconds
+
+			[[nodiscard]] float GetRate(COUNTER a_counter) const { return time > 0.0f ? static_cast<float>(counters[std::to_underlying(a_counter)]) / time : 0.0f; }
+
+			// units per havok query and microseconds per main thread query, to compare RaySpanMode settings
+			[[nodiscard]] float GetAverageRayLength() const
+			{
+				const auto queries = counters[std::to_underlying(COUNTER::kRayQueries)];
+				return queries > 0 ? static_cast<float>(counters[std::to_underlying(COUNTER::kRayLength)]) / static_cast<float>(queries) : 0.0f;
+			}
+			[[nodiscard]] float GetAverageQueryTime() const
+			{
+				const auto queries = counters[std::to_underlying(COUNTER::kSyncRayQueries)];
+				return queries > 0 ? static_cast<float>(timers[std::to_underlying(TIMER::kRayQuery)] * 1000.0 / static_cast<double>(queries)) : 0.0f;
+			}
+
+			[[nodiscard]] float GetSurfaceCacheHitRate() const
+			{
+				const auto lookups = counters[std::to_underlying(COUNTER::kSurfaceLookups)];
+				return lookups > 0 ? static_cast<float>(counters[std::to_underlying(COUNTER::kSurfaceCacheHits)]) / static_cast<float>(lookups) : 0.0f;
+			}
+
+			// screen fraction covered by splashes per splash raycast, to compare sampling modes
+			[[nodiscard]] double GetCoveragePerRay() const
+			{
+				const auto rays = counters[std::to_underlying(COUNTER::kSplashRays)];
+				return rays > 0 ? coverage / static_cast<double>(rays) : 0.0;
+			}
+		};
+
+		std::uint32_t frames{ 0 };
+		float         p50{ 0.0f };
+		float         p95{ 0.0f };
+		float         p99{ 0.0f };
+		float         max{ 0.0f };
+
+		std::array<Tier, std::to_underlying(Rain::TYPE::kInvalid) + 1> tiers{};
+	};
+
+	class Tracker : public ISingleton<Tracker>
+	{
+	public:
+		static constexpr std::size_t capacity{ 1024 };
+
+		void Add(COUNTER a_counter, std::uint32_t a_amount = 1) { current.counters[std::to_underlying(a_counter)] += a_amount; }
+		void AddTime(TIMER a_timer, float a_time) { current.time[std::to_underlying(a_timer)] += a_time; }
+		void AddCoverage(float a_coverage) { current.coverage += a_coverage; }
+
+		// closes the frame accumulated since the previous call
+		void EndFrame(Rain::TYPE a_tier, float a_delta);
+
+		[[nodiscard]] Report GetReport() const;
+		bool                 DumpCSV(const std::filesystem::path& a_path) const;
+
+		void Reset();
+
+	private:
+		std::array<Frame, capacity> frames{};
+		Frame                       current{};
+		std::size_t                 next{ 0 };
+		std::size_t                 size{ 0 };
+		std::uint64_t               total{ 0 };
+	};
+
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(TIMER a_timer) :
+			timer(a_timer),
+			start(std::chrono::steady_clock::now())
+		{}
+		~ScopedTimer()
+		{
+			Tracker::GetSingleton()->AddTime(timer, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer(ScopedTimer&&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+	private:
+		TIMER                                 timer;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	// approximate fraction of a square screen covered by a splash of a_scale at a_position, 0 when behind the camera
+	float GetScreenCoverage(const Engine::CameraState& a_camera, const Engine::Point3& a_position, float a_scale);
+
+	std::filesystem::path GetDefaultCSVPath();
+}
@@ -0,0 +1,137 @@
+#include "Surface.h"
+#include "Stats.h"
+
+namespace Surface
+{
+	TYPE GetType(std::uint32_t a_materialID)
+	{
+		switch (static_cast<MATERIAL>(a_materialID)) {
+		case MATERIAL::kStone:
+		case MATERIAL::kStoneBroken:
+		case MATERIAL::kStoneHeavy:
+		case MATERIAL::kStoneStairs:
+		case MATERIAL::kStoneAsStairs:
+		case MATERIAL::kStoneStairsBroken:
+		case MATERIAL::kGravel:
+			return TYPE::kStone;
+		case MATERIAL::kWood:
+		case MATERIAL::kWoodLight:
+		case MATERIAL::kWoodHeavy:
+		case MATERIAL::kWoodStairs:
+		case MATERIAL::kWoodAsStairs:
+		case MATERIAL::kBarrel:
+			return TYPE::kWood;
+		case MATERIAL::kMetalLight:
+		case MATERIAL::kMetalSolid:
+		case MATERIAL::kMetalHeavy:
+		case MATERIAL::kChainMetal:
+			return TYPE::kMetal;
+		case MATERIAL::kGrass:
+		case MATERIAL::kOrganic:
+		case MATERIAL::kOrganicLarge:
+			return TYPE::kFoliage;
+		case MATERIAL::kSnow:
+		case MATERIAL::kSnowStairs:
+		case MATERIAL::kIce:
+		case MATERIAL::kIceForm:
+			return TYPE::kSnow;
+		default:
+			return TYPE::kDefault;
+		}
+	}
+
+	std::size_t Cache::Hash(const Key& a_key)
+	{
+		// collidables are at least 16 byte aligned, fibonacci hashing spreads the remaining bits
+		const auto value = static_cast<std::uint64_t>(a_key.collidable >> 4) ^ a_key.shapeKey;
+		return static_cast<std::size_t>((value * 0x9E3779B97F4A7C15) >> 54);  // top log2(capacity) bits
+	}
+
+	std::optional<std::uint32_t> Cache::Find(const void* a_world, const Key& a_key)
+	{
+		std::scoped_lock locker(lock);
+
+		if (a_world != world) {
+			world = a_world;
+			slots.fill({});
+			size = 0;
+			lookups = 0;
+			hits = 0;
+		}
+
+		lookups++;
+		frameLookups++;
+
+		for (auto index = Hash(a_key);; index = (index + 1) & (capacity - 1)) {
+			const auto& slot = slots[index];
+			if (!slot.key.collidable) {
+				return std::nullopt;
+			}
+			if (slot.key.collidable == a_key.collidable && slot.key.shape == a_key.shape && slot.key.shapeKey == a_key.shapeKey) {
+				hits++;
+				frameHits++;
+				return slot.material;
+			}
+		}
+	}
+
+	void Cache::Store(const void* a_world, const Key& a_key, std::uint32_t a_material)
+	{
+		std::scoped_lock locker(lock);
+
+		// the world changed while the material was read, it belongs to the old one
+		if (a_world != world || !a_key.collidable) {
+			return;
+		}
+
+		// no deletions, so start over once probe chains get long
+		if (size >= maxLoad) {
+			slots.fill({});
+			size = 0;
+		}
+
+		// another thread may have stored the same sub-shape in the meantime
+		auto index = Hash(a_key);
+		for (; slots[index].key.collidable; index = (index + 1) & (capacity - 1)) {
+			const auto& key = slots[index].key;
+			if (key.collidable == a_key.collidable && key.shape == a_key.shape && key.shapeKey == a_key.shapeKey) {
+				return;
+			}
+		}
+
+		slots[index] = { a_key, a_material };
+		size++;
+	}
+
+	void Cache::Update(const void* a_cell)
+	{
+		std::scoped_lock locker(lock);
+
+		const auto tracker = Stats::Tracker::GetSingleton();
+		tracker->Add(Stats::COUNTER::kSurfaceLookups, frameLookups);
+		tracker->Add(Stats::COUNTER::kSurfaceCacheHits, frameHits);
+		frameLookups = 0;
+		frameHits = 0;
+
+		// collidables of a cell that went away may have their addresses reused by the next one
+		if (a_cell != cell) {
+			cell = a_cell;
+			slots.fill({});
+			size = 0;
+		}
+	}
+
+	void Cache::Clear()
+	{
+		std::scoped_lock locker(lock);
+		slots.fill({});
+		size = 0;
+	}
+
+	void Cache::ResetCounters()
+	{
+		std::scoped_lock locker(lock);
+		lookups = 0;
+		hits = 0;
+	}
+}
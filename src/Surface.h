@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Engine.h"
+
+namespace Surface
+{
+	enum class TYPE : std::uint8_t
+	{
+		kDefault,
+		kStone,
+		kWood,
+		kMetal,
+		kFoliage,
+		kSnow,
+
+		kTotal
+	};
+
+	// the havok materials GetType tells apart, same values as the game's material ids
+	enum class MATERIAL : std::uint32_t
+	{
+		kStoneBroken = 131151687,
+		kMetalLight = 346811165,
+		kWoodLight = 365420259,
+		kSnow = 398949039,
+		kGravel = 428587608,
+		kChainMetal = 438912228,
+		kWood = 500811281,
+		kBarrel = 732141076,
+		kIce = 873356572,
+		kStoneStairs = 899511101,
+		kMetalSolid = 1288358971,
+		kOrganicLarge = 1322093133,
+		kWoodStairs = 1461712277,
+		kSnowStairs = 1560365355,
+		kStoneHeavy = 1570821952,
+		kWoodAsStairs = 1803571212,
+		kGrass = 1848600814,
+		kStoneAsStairs = 1886078335,
+		kMetalHeavy = 2229413539,
+		kIceForm = 2431524493,
+		kStoneStairsBroken = 2892392795,
+		kOrganic = 2974920155,
+		kWoodHeavy = 3070783559,
+		kStone = 3741512247
+	};
+
+	TYPE GetType(std::uint32_t a_materialID);
+
+	// havok material per collidable sub-shape, open addressing with linear probing; flushed when the physics world or the player's cell changes
+	// the ray caster asks it while it holds the world lock and only walks the shape hierarchy on a miss, so it is shared with the job pool
+	// a collidable freed with its cell can have its address reused, so entries also match on the collidable's root shape
+	class Cache : public ISingleton<Cache>
+	{
+	public:
+		struct Key
+		{
+			std::uintptr_t collidable{ 0 };
+			std::uintptr_t shape{ 0 };     // root shape of the collidable
+			std::uint64_t  shapeKey{ 0 };  // shape keys down to the sub-shape that was hit, folded into one
+		};
+
+		// a_resolve() reads the material from the hit body on a miss
+		template <class F>
+		std::uint32_t Resolve(const void* a_world, const Key& a_key, F&& a_resolve)
+		{
+			if (const auto material = Find(a_world, a_key)) {
+				return *material;
+			}
+
+			const auto material = a_resolve();
+			Store(a_world, a_key, material);
+			return material;
+		}
+
+		// main thread, once per frame: flushes on a cell change and hands the frame's lookups to the frame stats
+		void Update(const void* a_cell);
+
+		void Clear();
+		void ResetCounters();
+
+		[[nodiscard]] std::uint64_t GetLookups() const { return lookups; }
+		[[nodiscard]] float         GetHitRate() const { return lookups > 0 ? static_cast<float>(hits) / static_cast<float>(lookups) : 0.0f; }
+
+	private:
+		struct Slot
+		{
+			Key           key;
+			std::uint32_t material{ 0 };
+		};
+
+		static constexpr std::size_t capacity{ 1024 };  // power of two
+		static constexpr std::size_t maxLoad{ capacity * 3 / 4 };
+
+		static std::size_t Hash(const Key& a_key);
+
+		std::optional<std::uint32_t> Find(const void* a_world, const Key& a_key);
+		void                         Store(const void* a_world, const Key& a_key, std::uint32_t a_material);
+
+		mutable std::mutex         lock;
+		std::array<Slot, capacity> slots{};
+		std::size_t                size{ 0 };
+		const void*                world{ nullptr };
+		const void*                cell{ nullptr };
+
+		std::uint64_t lookups{ 0 };
+		std::uint64_t hits{ 0 };
+		std::uint32_t frameLookups{ 0 };  // since the last Update
+		std::uint32_t frameHits{ 0 };
+	};
+}
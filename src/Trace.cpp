@@ -0,0 +1,659 @@
+#include "Trace.h"
+#include "HeightCache.h"
+#include "Scheduler.h"
+#include "Settings.h"
+#include "SpanCache.h"
+#include "Stats.h"
+#include "Util.h"
+
+namespace Trace
+{
+	namespace detail
+	{
+		struct FrameData
+		{
+			Frame                                           frame;
+			std::optional<std::vector<Bound>>               water;
+			std::optional<std::vector<Actors::Bound>>       actors;
+			std::vector<std::optional<Engine::RayHit>>      rays;
+			std::vector<std::uint32_t>                      cells;
+			std::vector<std::optional<Engine::HeightRange>> ranges;
+		};
+
+		class Reader
+		{
+		public:
+			explicit Reader(const std::filesystem::path& a_path) :
+				file(a_path, std::ios::binary)
+			{}
+
+			template <class T>
+			bool read(T& a_value)
+			{
+				file.read(reinterpret_cast<char*>(&a_value), sizeof(T));
+				return static_cast<bool>(file);
+			}
+
+			template <class T>
+			bool read_optional(std::optional<T>& a_value)
+			{
+				std::uint8_t present = 0;
+				if (!read(present)) {
+					return false;
+				}
+				if (present) {
+					T value{};
+					if (!read(value)) {
+						return false;
+					}
+					a_value = value;
+				}
+				return true;
+			}
+
+			[[nodiscard]] bool is_open() const { return file.is_open(); }
+
+		private:
+			std::ifstream file;
+		};
+
+		std::optional<std::pair<std::uint64_t, std::vector<FrameData>>> Load(const std::filesystem::path& a_path)
+		{
+			Reader reader(a_path);
+			if (!reader.is_open()) {
+				logger::error("Failed to open trace {}", a_path.string());
+				return std::nullopt;
+			}
+
+			std::uint32_t fileMagic = 0;
+			std::uint32_t fileVersion = 0;
+			std::uint64_t seed = 0;
+			if (!reader.read(fileMagic) || !reader.read(fileVersion) || !reader.read(seed) || fileMagic != magic || fileVersion != version) {
+				logger::error("Invalid trace header in {}", a_path.string());
+				return std::nullopt;
+			}
+
+			std::vector<FrameData>                    frames;
+			std::optional<std::vector<Bound>>         pendingWater;
+			std::optional<std::vector<Actors::Bound>> pendingActors;
+
+			RECORD record{};
+			while (reader.read(record)) {
+				switch (record) {
+				case RECORD::kFrame:
+					{
+						FrameData data;
+						auto&     frame = data.frame;
+						if (!reader.read(frame.particleDensity) || !reader.read(frame.delta) || !reader.read(frame.windSpeed) || !reader.read(frame.windAngle) ||
+							!reader.read(frame.playerPos) || !reader.read_optional(frame.camera) || !reader.read_optional(frame.frustum) || !reader.read(frame.time) ||
+							!reader.read(frame.budgetScale) || !reader.read(frame.cell)) {
+							return std::make_pair(seed, std::move(frames));  // truncated, keep what was complete
+						}
+						data.water = std::exchange(pendingWater, std::nullopt);
+						data.actors = std::exchange(pendingActors, std::nullopt);
+						frames.push_back(std::move(data));
+					}
+					break;
+				case RECORD::kRay:
+					{
+						std::optional<Engine::RayHit> hit;
+						std::uint8_t                  hasHit = 0;
+						if (!reader.read(hasHit)) {
+							return std::make_pair(seed, std::move(frames));
+						}
+						if (hasHit) {
+							Engine::RayHit rayHit;
+							if (!reader.read(rayHit.position) || !reader.read(rayHit.fraction) || !reader.read(rayHit.type) || !reader.read(rayHit.material)) {
+								return std::make_pair(seed, std::move(frames));
+							}
+							hit = rayHit;
+						}
+						if (!frames.empty()) {
+							frames.back().rays.push_back(hit);
+						}
+					}
+					break;
+				case RECORD::kWater:
+					{
+						std::uint32_t count = 0;
+						if (!reader.read(count)) {
+							return std::make_pair(seed, std::move(frames));
+						}
+						std::vector<Bound> bounds(count);
+						for (auto& bound : bounds) {
+							if (!reader.read(bound)) {
+								return std::make_pair(seed, std::move(frames));
+							}
+						}
+						pendingWater = std::move(bounds);
+					}
+					break;
+				case RECORD::kActors:
+					{
+						std::uint32_t count = 0;
+						if (!reader.read(count)) {
+							return std::make_pair(seed, std::move(frames));
+						}
+						std::vector<Actors::Bound> bounds(count);
+						for (auto& bound : bounds) {
+							if (!reader.read(bound)) {
+								return std::make_pair(seed, std::move(frames));
+							}
+						}
+						pendingActors = std::move(bounds);
+					}
+					break;
+				case RECORD::kCell:
+					{
+						std::uint32_t cell = 0;
+						if (!reader.read(cell)) {
+							return std::make_pair(seed, std::move(frames));
+						}
+						if (!frames.empty()) {
+							frames.back().cells.push_back(cell);
+						}
+					}
+					break;
+				case RECORD::kRange:
+					{
+						std::optional<Engine::HeightRange> range;
+						if (!reader.read_optional(range)) {
+							return std::make_pair(seed, std::move(frames));
+						}
+						if (!frames.empty()) {
+							frames.back().ranges.push_back(range);
+						}
+					}
+					break;
+				default:
+					logger::error("Unknown trace record {} in {}", std::to_underlying(record), a_path.string());
+					return std::make_pair(seed, std::move(frames));
+				}
+			}
+
+			return std::make_pair(seed, std::move(frames));
+		}
+
+		// cell moves and height ranges are played back in the order they were looked up, like the rays,
+		// so every span comes out as long as it was recorded and each ray is handed the hit it got
+		class ReplayRayCaster final : public Engine::IRayCaster
+		{
+		public:
+			explicit ReplayRayCaster(std::uint32_t a_cellCount) :
+				cells(a_cellCount + 1)
+			{}
+
+			const void* GetWorld(Engine::Cell*) const override { return this; }
+
+			// doesn't own anything, the replay outlives its batch
+			Engine::WorldRef AcquireWorld(Engine::Cell*) override { return { Engine::WorldRef{}, this }; }
+
+			std::optional<Engine::RayHit> CastRay(Engine::Cell*, const Engine::Point3&, const Engine::Point3&) override { return Next(); }
+			std::optional<Engine::RayHit> CastRay(const Engine::WorldRef&, const Engine::Point3&, const Engine::Point3&) override { return Next(); }
+
+			std::optional<Engine::HeightRange> GetHeightRange(Engine::Cell*) const override
+			{
+				return frame && nextRange < frame->ranges.size() ? frame->ranges[nextRange++] : std::nullopt;
+			}
+
+			Engine::Cell* GetLoadedCell(Engine::Cell* a_cell, const Engine::Point3&) const override
+			{
+				return frame && nextCell < frame->cells.size() ? GetCell(frame->cells[nextCell++]) : a_cell;
+			}
+
+			// a placeholder per recorded cell, never dereferenced
+			[[nodiscard]] Engine::Cell* GetCell(std::uint32_t a_id) const
+			{
+				return a_id > 0 && a_id < cells.size() ? reinterpret_cast<Engine::Cell*>(const_cast<std::uint8_t*>(&cells[a_id])) : nullptr;
+			}
+
+			void SetFrame(const FrameData* a_frame)
+			{
+				frame = a_frame;
+				next = 0;
+				nextCell = 0;
+				nextRange = 0;
+			}
+
+			std::uint64_t rayCasts{ 0 };
+			std::uint64_t rayHits{ 0 };
+
+		private:
+			std::optional<Engine::RayHit> Next()
+			{
+				rayCasts++;
+				if (!frame || next >= frame->rays.size()) {
+					return std::nullopt;
+				}
+				const auto& hit = frame->rays[next++];
+				if (hit) {
+					rayHits++;
+				}
+				return hit;
+			}
+
+			std::vector<std::uint8_t> cells;
+			const FrameData*          frame{ nullptr };
+			std::size_t               next{ 0 };
+			mutable std::size_t       nextCell{ 0 };
+			mutable std::size_t       nextRange{ 0 };
+		};
+
+		class ReplayWaterSystem final : public Engine::IWaterSystem
+		{
+		public:
+			bool        IsEnabled() const override { return !bounds.empty(); }
+			std::size_t GetSignature() const override { return signature; }
+
+			void ForEachBound(const BoundVisitor& a_visitor) const override
+			{
+				for (const auto& [center, size] : bounds) {
+					a_visitor(center, size);
+				}
+			}
+
+			void AddRipple(const Engine::Point3&, float) override { ripples++; }
+
+			void SetBounds(std::vector<Bound> a_bounds)
+			{
+				bounds = std::move(a_bounds);
+				signature++;
+			}
+
+			std::uint64_t ripples{ 0 };
+
+		private:
+			std::vector<Bound> bounds;
+			std::size_t        signature{ 0 };
+		};
+
+		class ReplayCamera final : public Engine::ICamera
+		{
+		public:
+			std::optional<Engine::CameraState>    GetState() const override { return frame ? frame->camera : std::nullopt; }
+			std::optional<Sampler::FrustumPlanes> GetFrustum() const override { return frame ? frame->frustum : std::nullopt; }
+
+			const Frame* frame{ nullptr };
+		};
+
+		class ReplaySpawner final : public Engine::IParticleSpawner
+		{
+		public:
+			explicit ReplaySpawner(const ReplayCamera& a_camera) :
+				camera(a_camera)
+			{}
+
+			void Spawn(Engine::Cell*, const char*, float, const Engine::Point3& a_position, float a_scale) override
+			{
+				spawns++;
+				if (const auto state = camera.GetState()) {
+					coverage += Stats::GetScreenCoverage(*state, a_position, a_scale);
+				}
+			}
+
+			std::uint64_t spawns{ 0 };
+			double        coverage{ 0.0 };
+
+		private:
+			const ReplayCamera& camera;
+		};
+
+		// actor probes aren't part of the trace, only the actor index the height cache checks is
+		class ReplayActors final : public Engine::IActorSource
+		{
+		public:
+			std::size_t                       GetHandleCount() const override { return 0; }
+			Handle                            GetHandle(std::size_t) const override { return player; }
+			std::optional<Engine::ActorBound> GetBound(Handle) const override { return std::nullopt; }
+		};
+
+		class ReplayTaskQueue final : public Engine::ITaskQueue
+		{
+		public:
+			void AddTask(std::function<void()> a_task) override { tasks.push_back(std::move(a_task)); }
+
+			void Run()
+			{
+				// tasks may queue more tasks
+				for (std::size_t i = 0; i < tasks.size(); i++) {
+					std::invoke(tasks[i]);
+				}
+				tasks.clear();
+			}
+
+		private:
+			std::vector<std::function<void()>> tasks;
+		};
+
+		void ResetPipelineState(std::uint64_t a_seed)
+		{
+			util::RNG::Seed(a_seed);
+			Sampler::ResetSequences();
+			Splashes::emission.Reset();
+			Splashes::sharedEmission.Reset();
+			Splashes::actorEmission.Reset();
+			RayCast::pendingRippleRays = 0;
+			Ripples::Dynamic::emission.Reset();
+			Ripples::Dynamic::fastPathEmission.Reset();
+			RayCast::HeightCache::GetSingleton()->Clear();
+			RayCast::SpanCache::GetSingleton()->Clear();
+			RayCast::Scheduler::GetSingleton()->Reset();
+			RayCast::Scheduler::GetSingleton()->Pin(std::nullopt);
+			Actors::Index::GetSingleton()->Clear();
+		}
+	}
+
+	std::filesystem::path GetDefaultPath()
+	{
+		auto path = logger::log_directory();
+		if (!path) {
+			return {};
+		}
+
+		*path /= fmt::format("{}.trace", Version::PROJECT);
+		return *path;
+	}
+
+	class Recorder::RecordingRayCaster final : public Engine::IRayCaster
+	{
+	public:
+		const void* GetWorld(Engine::Cell* a_cell) const override
+		{
+			return inner->GetWorld(a_cell);
+		}
+
+		Engine::WorldRef AcquireWorld(Engine::Cell* a_cell) override
+		{
+			return inner->AcquireWorld(a_cell);
+		}
+
+		bool TryLockWorld(const Engine::WorldRef& a_world) override
+		{
+			return inner->TryLockWorld(a_world);
+		}
+
+		void UnlockWorld(const Engine::WorldRef& a_world) override
+		{
+			inner->UnlockWorld(a_world);
+		}
+
+		std::optional<Engine::HeightRange> GetHeightRange(Engine::Cell* a_cell) const override
+		{
+			auto range = inner->GetHeightRange(a_cell);
+			Recorder::GetSingleton()->RecordRange(range);
+			return range;
+		}
+
+		Engine::Cell* GetLoadedCell(Engine::Cell* a_cell, const Engine::Point3& a_pos) const override
+		{
+			const auto cell = inner->GetLoadedCell(a_cell, a_pos);
+			Recorder::GetSingleton()->RecordCell(cell);
+			return cell;
+		}
+
+		std::optional<Engine::WorldSpace> GetWorldSpace(Engine::Cell* a_cell) const override
+		{
+			return inner->GetWorldSpace(a_cell);
+		}
+
+		std::optional<Engine::RayHit> CastRay(Engine::Cell* a_cell, const Engine::Point3& a_from, const Engine::Point3& a_to) override
+		{
+			auto hit = inner->CastRay(a_cell, a_from, a_to);
+			Recorder::GetSingleton()->RecordRay(hit);
+			return hit;
+		}
+
+		std::optional<Engine::RayHit> CastRay(const Engine::WorldRef& a_world, const Engine::Point3& a_from, const Engine::Point3& a_to) override
+		{
+			auto hit = inner->CastRay(a_world, a_from, a_to);
+			Recorder::GetSingleton()->RecordRay(hit);
+			return hit;
+		}
+
+		Engine::IRayCaster* inner{ nullptr };
+	};
+
+	bool Recorder::Start(const std::filesystem::path& a_path, std::uint64_t a_seed)
+	{
+		Stop();
+
+		file.open(a_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			logger::error("Failed to open trace {} for writing", a_path.string());
+			return false;
+		}
+
+		write(magic);
+		write(version);
+		write(a_seed);
+
+		static RecordingRayCaster recordingRayCaster;
+
+		auto& interfaces = Engine::Get();
+		gameRayCaster = interfaces.rayCaster;
+		recordingRayCaster.inner = gameRayCaster;
+		interfaces.rayCaster = &recordingRayCaster;
+
+		waterSignature = 0;
+		actors.clear();
+		cellIDs.clear();
+		frames = 0;
+		recording = true;
+
+		logger::info("Recording trace to {} (seed {})", a_path.string(), a_seed);
+
+		return true;
+	}
+
+	void Recorder::Stop()
+	{
+		if (!recording) {
+			return;
+		}
+
+		recording = false;
+		Engine::Get().rayCaster = gameRayCaster;
+		file.close();
+
+		logger::info("Stopped recording trace ({} frames)", frames);
+	}
+
+	void Recorder::RecordWater()
+	{
+		const auto waterSystem = Engine::Get().waterSystem;
+
+		std::vector<Bound> bounds;
+		if (waterSystem->IsEnabled()) {
+			waterSystem->ForEachBound([&](const Engine::Point3& a_center, const Engine::Point3& a_size) {
+				bounds.push_back({ a_center, a_size });
+			});
+		}
+
+		write(RECORD::kWater);
+		write(static_cast<std::uint32_t>(bounds.size()));
+		for (const auto& bound : bounds) {
+			write(bound);
+		}
+	}
+
+	void Recorder::RecordActors()
+	{
+		write(RECORD::kActors);
+		write(static_cast<std::uint32_t>(actors.size()));
+		for (const auto& bound : actors) {
+			write(bound);
+		}
+	}
+
+	std::uint32_t Recorder::GetCellID(Engine::Cell* a_cell)
+	{
+		if (!a_cell) {
+			return 0;
+		}
+		return cellIDs.try_emplace(a_cell, static_cast<std::uint32_t>(cellIDs.size() + 1)).first->second;
+	}
+
+	void Recorder::RecordFrame(Engine::Cell* a_cell, float a_particleDensity, float a_delta, float a_windSpeed, float a_windAngle, const Engine::Point3& a_playerPos)
+	{
+		const auto& interfaces = Engine::Get();
+
+		if (const auto signature = interfaces.waterSystem->IsEnabled() ? interfaces.waterSystem->GetSignature() : 0; frames == 0 || signature != waterSignature) {
+			waterSignature = signature;
+			RecordWater();
+		}
+
+		// after the hook's index update, before anything is sampled
+		static std::vector<Actors::Bound> bounds;
+		Actors::Index::GetSingleton()->GetAll(bounds);
+		if (frames == 0 || bounds != actors) {
+			actors = bounds;
+			RecordActors();
+		}
+
+		const auto write_optional = [this](const auto& a_value) {
+			write(static_cast<std::uint8_t>(a_value.has_value()));
+			if (a_value) {
+				write(*a_value);
+			}
+		};
+
+		write(RECORD::kFrame);
+		write(a_particleDensity);
+		write(a_delta);
+		write(a_windSpeed);
+		write(a_windAngle);
+		write(a_playerPos);
+		write_optional(interfaces.camera->GetState());
+		write_optional(interfaces.camera->GetFrustum());
+		write(RayCast::FrameClock::GetSingleton()->Now());
+		write(RayCast::Scheduler::GetSingleton()->GetScale());
+		write(GetCellID(a_cell));
+
+		frames++;
+	}
+
+	void Recorder::RecordRay(const std::optional<Engine::RayHit>& a_hit)
+	{
+		write(RECORD::kRay);
+		write(static_cast<std::uint8_t>(a_hit.has_value()));
+		if (a_hit) {
+			write(a_hit->position);
+			write(a_hit->fraction);
+			write(a_hit->type);
+			write(a_hit->material);
+		}
+	}
+
+	void Recorder::RecordCell(Engine::Cell* a_cell)
+	{
+		write(RECORD::kCell);
+		write(GetCellID(a_cell));
+	}
+
+	void Recorder::RecordRange(const std::optional<Engine::HeightRange>& a_range)
+	{
+		write(RECORD::kRange);
+		write(static_cast<std::uint8_t>(a_range.has_value()));
+		if (a_range) {
+			write(*a_range);
+		}
+	}
+
+	std::optional<ReplayResult> Replay(const std::filesystem::path& a_path)
+	{
+		if (Recorder::GetSingleton()->IsRecording()) {
+			logger::error("Can't replay a trace while recording one");
+			return std::nullopt;
+		}
+
+		auto trace = detail::Load(a_path);
+		if (!trace) {
+			return std::nullopt;
+		}
+
+		auto& [seed, frames] = *trace;
+
+		std::uint32_t cellCount = 0;
+		for (const auto& data : frames) {
+			cellCount = std::max(cellCount, data.frame.cell);
+			for (const auto cell : data.cells) {
+				cellCount = std::max(cellCount, cell);
+			}
+		}
+
+		detail::ReplayRayCaster   rayCaster{ cellCount };
+		detail::ReplayWaterSystem waterSystem;
+		detail::ReplayCamera      camera;
+		detail::ReplaySpawner     spawner{ camera };
+		detail::ReplayTaskQueue   tasks;
+		detail::ReplayActors      actors;
+
+		// the game's rays still go to the game, and none of the trace's are left behind for it
+		const auto batch = RayCast::Batch::GetSingleton();
+		batch->Flush();
+
+		auto&      interfaces = Engine::Get();
+		const auto gameInterfaces = interfaces;
+		interfaces = { &rayCaster, &waterSystem, &camera, &spawner, &tasks, &actors };
+
+		const auto settings = Settings::Manager::GetSingleton();
+		const auto rainType = settings->GetRainType();
+
+		// the trace's own frame times and budget scales, nothing below may depend on how fast this machine replays it
+		const auto clock = RayCast::FrameClock::GetSingleton();
+		const auto scheduler = RayCast::Scheduler::GetSingleton();
+		const auto gameTime = clock->Now();
+
+		detail::ResetPipelineState(seed);
+
+		ReplayResult result;
+		for (auto& data : frames) {
+			if (data.water) {
+				waterSystem.SetBounds(std::move(*data.water));
+			}
+			if (data.actors) {
+				Actors::Index::GetSingleton()->Assign(*data.actors);
+			}
+			clock->Set(data.frame.time);
+			scheduler->Pin(data.frame.budgetScale);
+			camera.frame = &data.frame;
+			rayCaster.SetFrame(&data);
+
+			const auto cell = rayCaster.GetCell(data.frame.cell);
+
+			const auto start = std::chrono::steady_clock::now();
+
+			if (const auto rain = settings->GetRain(data.frame.particleDensity)) {
+				if (rain->splash.enabled) {
+					Splashes::Emit(rain, cell, data.frame.playerPos, data.frame.delta);
+				}
+				if (rain->ripple.enabled) {
+					Ripples::Dynamic::Emit(rain, cell, data.frame.playerPos, data.frame.delta);
+				}
+			}
+			tasks.Run();
+
+			const auto frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			result.time += frameTime;
+			result.maxFrameTime = std::max(result.maxFrameTime, frameTime);
+			result.frames++;
+		}
+
+		batch->Flush();
+		tasks.Run();
+
+		result.rayCasts = rayCaster.rayCasts;
+		result.rayHits = rayCaster.rayHits;
+		result.spawns = spawner.spawns;
+		result.coverage = spawner.coverage;
+		result.ripples = waterSystem.ripples;
+
+		interfaces = gameInterfaces;
+		settings->SetRainType(rainType);
+
+		detail::ResetPipelineState(settings->Get()->seed);
+		clock->Set(gameTime);
+
+		return result;
+	}
+}
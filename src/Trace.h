@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ActorIndex.h"
+#include "Engine.h"
+
+// compact binary capture of per-frame rain inputs and raycast results, and an offline replay driver for them
+namespace Trace
+{
+	inline constexpr std::uint32_t magic{ 0x534F5354 };  // "TSOS"
+	inline constexpr std::uint32_t version{ 5 };
+
+	enum class RECORD : std::uint8_t
+	{
+		kFrame = 1,
+		kRay,
+		kWater,
+		kActors,
+		kCell,  // a ray moved into the loaded cell it falls in
+		kRange  // a cell's height range was looked up
+	};
+
+	struct Frame
+	{
+		float                                 particleDensity{ 0.0f };
+		float                                 delta{ 0.0f };
+		float                                 windSpeed{ 0.0f };
+		float                                 windAngle{ 0.0f };
+		Engine::Point3                        playerPos{};
+		std::optional<Engine::CameraState>    camera{};
+		std::optional<Sampler::FrustumPlanes> frustum{};
+		float                                 time{ 0.0f };         // RayCast::FrameClock, the cache lifetimes run on it
+		float                                 budgetScale{ 1.0f };  // RayCast::Scheduler, pinned while replaying
+		std::uint32_t                         cell{ 0 };            // the player's, cells are numbered in the order the recording met them, 0 = none
+	};
+
+	struct Bound
+	{
+		Engine::Point3 center{};
+		Engine::Point3 size{};
+	};
+
+	std::filesystem::path GetDefaultPath();
+
+	class Recorder : public ISingleton<Recorder>
+	{
+	public:
+		bool Start(const std::filesystem::path& a_path, std::uint64_t a_seed);
+		void Stop();
+
+		[[nodiscard]] bool IsRecording() const { return recording; }
+
+		void RecordFrame(Engine::Cell* a_cell, float a_particleDensity, float a_delta, float a_windSpeed, float a_windAngle, const Engine::Point3& a_playerPos);
+		void RecordRay(const std::optional<Engine::RayHit>& a_hit);
+		void RecordCell(Engine::Cell* a_cell);
+		void RecordRange(const std::optional<Engine::HeightRange>& a_range);
+
+	private:
+		class RecordingRayCaster;
+
+		template <class T>
+		void write(const T& a_value)
+		{
+			file.write(reinterpret_cast<const char*>(&a_value), sizeof(T));
+		}
+
+		void RecordWater();
+		void RecordActors();
+
+		[[nodiscard]] std::uint32_t GetCellID(Engine::Cell* a_cell);
+
+		std::ofstream                                    file;
+		Engine::IRayCaster*                              gameRayCaster{ nullptr };
+		std::size_t                                      waterSignature{ 0 };
+		std::vector<Actors::Bound>                       actors;   // as last recorded, only written again once the index changes
+		std::unordered_map<Engine::Cell*, std::uint32_t> cellIDs;  // see Frame::cell
+		std::uint64_t                                    frames{ 0 };
+		bool                                             recording{ false };
+	};
+
+	struct ReplayResult
+	{
+		std::uint64_t frames{ 0 };
+		std::uint64_t rayCasts{ 0 };
+		std::uint64_t rayHits{ 0 };
+		std::uint64_t spawns{ 0 };
+		std::uint64_t ripples{ 0 };
+		double        coverage{ 0.0 };  // summed Stats::GetScreenCoverage of every spawn
+		double        time{ 0.0 };  // milliseconds spent sampling, scheduling and draining
+		double        maxFrameTime{ 0.0 };
+	};
+
+	// feeds the trace back through the sampling, scheduling and batch code with the engine interfaces swapped for recorded data
+	// the recorded cells are replaced by placeholders, every ray lands in the one the recording resolved it to
+	std::optional<ReplayResult> Replay(const std::filesystem::path& a_path);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// plain data shared by the engine seam and the rain pipeline, nothing in here knows about the game
+namespace Engine
+{
+	inline constexpr float PI{ std::numbers::pi_v<float> };
+	inline constexpr float TWO_PI{ 2.0f * PI };
+	inline constexpr float HALF_PI{ 0.5f * PI };
+
+	constexpr float DegToRad(float a_degrees) { return a_degrees * (PI / 180.0f); }
+
+	struct Point3
+	{
+		[[nodiscard]] Point3 operator+(const Point3& a_rhs) const { return { x + a_rhs.x, y + a_rhs.y, z + a_rhs.z }; }
+		[[nodiscard]] Point3 operator-(const Point3& a_rhs) const { return { x - a_rhs.x, y - a_rhs.y, z - a_rhs.z }; }
+		[[nodiscard]] Point3 operator*(float a_scale) const { return { x * a_scale, y * a_scale, z * a_scale }; }
+
+		[[nodiscard]] bool operator==(const Point3&) const = default;
+
+		[[nodiscard]] float Dot(const Point3& a_rhs) const { return x * a_rhs.x + y * a_rhs.y + z * a_rhs.z; }
+		[[nodiscard]] float GetDistance(const Point3& a_rhs) const { return std::sqrt((*this - a_rhs).Dot(*this - a_rhs)); }
+
+		float x{ 0.0f };
+		float y{ 0.0f };
+		float z{ 0.0f };
+	};
+
+	// a loaded cell, only ever handled by pointer; the game side casts it back to its own cell type
+	struct Cell;
+}
@@ -1,59 +1,24 @@
 #pragma once
 
+#include "ActorIndex.h"
+#include "Engine.h"
+#include "Exposure.h"
+#include "HeightCache.h"
+#include "RNG.h"
+#include "RayBatch.h"
+#include "Scheduler.h"
+#include "Settings.h"
+#include "SpanCache.h"
+#include "Stats.h"
+#include "WaterIndex.h"
+
 namespace util
 {
-	class RNG
+	inline std::pair<bool, float> point_in_water(const Engine::Point3& a_pos)
 	{
-	public:
-		static RNG* GetSingleton()
-		{
-			static RNG singleton;
-			return &singleton;
-		}
-
-		float generate(float a_min, float a_max)
-		{
-			std::uniform_real_distribution<float> distr(a_min, a_max);
-			return distr(rng);
-		}
-
-		float generate()
-		{
-			return XoshiroCpp::FloatFromBits(rng());
-		}
-
-	private:
-		RNG() :
-			rng(std::chrono::steady_clock::now().time_since_epoch().count())
-		{}
-
-		RNG(RNG const&) = delete;
-		RNG(RNG&&) = delete;
-		~RNG() = default;
-		RNG& operator=(RNG const&) = delete;
-		RNG& operator=(RNG&&) = delete;
-
-		XoshiroCpp::Xoshiro128Plus rng;
-	};
-
-	inline std::pair<bool, float> point_in_water(const RE::NiPoint3& a_pos)
-	{
-		if (auto waterSystem = RE::TESWaterSystem::GetSingleton(); waterSystem->enabled) {
-			for (const auto& waterObject : waterSystem->waterObjects) {
-				if (waterObject) {
-					for (const auto& bound : waterObject->multiBounds) {
-						if (bound) {
-							if (auto size{ bound->size }; size.z <= 10.0f) {  //avoid sloped water
-								auto center{ bound->center };
-								const auto boundMin = center - size;
-								const auto boundMax = center + size;
-								if (!(a_pos.x < boundMin.x || a_pos.x > boundMax.x || a_pos.y < boundMin.y || a_pos.y > boundMax.y)) {
-									return { true, center.z };
-								}
-							}
-						}
-					}
-				}
+		if (Engine::Get().waterSystem->IsEnabled()) {
+			if (const auto waterHeight = Water::Index::GetSingleton()->GetWaterHeight(a_pos.x, a_pos.y)) {
+				return { true, *waterHeight };
 			}
 		}
 		return { false, 0.0f };
@@ -66,183 +31,507 @@ namespace RayCast
 
 	struct Input
 	{
-		RE::NiPoint3 rayOrigin{};
+		Engine::Point3 rayOrigin{};
 	};
 
 	struct Output
 	{
-		RE::NiPoint3 hitPos{};
-		RE::NiMatrix3 normal{};
+		Engine::Point3 hitPos{};
+		float         yaw{ 0.0f };  // radians about the vertical axis
+		Surface::TYPE surface{ Surface::TYPE::kDefault };
 		bool hitActor{ false };
 		bool hitWater{ false };
 	};
 
-	inline std::optional<RE::NiPoint3> GenerateRandomPointAroundPlayer(float a_radius, const RE::NiPoint3& a_posIn, bool a_inPlayerFOV)
+	// what the per-ray helpers branch on, taken from the snapshot once per drain instead of once per ray
+	// the lookup stages are template arguments, so a drain with them off compiles without them (see Batch::Drain)
+	template <bool HEIGHT_CACHE, bool EXPOSURE_MAPS>
+	struct RayOptions
 	{
-		const float r = a_radius * std::sqrtf(RNG::GetSingleton()->generate());
-		const float theta = RNG::GetSingleton()->generate() * RE::NI_TWO_PI;
+		static constexpr bool heightCache{ HEIGHT_CACHE };
+		static constexpr bool exposureMaps{ EXPOSURE_MAPS };
+
+		Settings::RAY_SPAN raySpan{ Settings::RAY_SPAN::kTwoPhase };
+	};
+
+	// rays keep the cell they were queued in, by the time they resolve the player may have crossed into another one
+	// and splashes near a border belong to the neighbouring cell anyway, main thread only
+	inline Engine::Cell* GetLoadedCell(Engine::Cell* a_cell, const Engine::Point3& a_pos)
+	{
+		return Engine::Get().rayCaster->GetLoadedCell(a_cell, a_pos);
+	}
+
+	// short vertical probe above a surface point, anything in the way shelters it from rain
+	inline Span GetShelterSpan(const Engine::Point3& a_pos, float a_height, float a_clearance = 1.0f)
+	{
+		return { { a_pos.x, a_pos.y, a_pos.z + a_height }, { a_pos.x, a_pos.y, a_pos.z + a_clearance } };
+	}
 
-		const RE::NiPoint3 randPoint{
-			a_posIn.x + r * std::cosf(theta),
-			a_posIn.y + r * std::sinf(theta),
-			a_posIn.z
+	// a cell without a physics world has nothing to stop the rain, the async path follows the same rule
+	inline bool IsSheltered(Engine::Cell* a_cell, const Span& a_span)
+	{
+		const auto rayCaster = Engine::Get().rayCaster;
+		if (!rayCaster->GetWorld(a_cell)) {
+			return false;
+		}
+
+		const auto& [from, to] = a_span;
+		return rayCaster->CastRay(a_cell, from, to).has_value();
+	}
+
+	// full height vertical ray through the sample point
+	inline Span GetRaySpan(const Input& a_input)
+	{
+		constexpr auto height = 9999.0f;
+
+		return { { a_input.rayOrigin.x, a_input.rayOrigin.y, a_input.rayOrigin.z + height }, { a_input.rayOrigin.x, a_input.rayOrigin.y, a_input.rayOrigin.z - height } };
+	}
+
+	// tight span from the cell's height range and the sample altitude, falling back to the full span depending on RaySpanMode
+	template <class O>
+	RaySpans GetRaySpans(const O& a_options, Engine::Cell* a_cell, const Input& a_input)
+	{
+		constexpr auto headroom = 256.0f;  // around the sample altitude, which is the player's
+		constexpr auto margin = 64.0f;
+
+		const auto full = GetRaySpan(a_input);
+
+		const auto mode = a_options.raySpan;
+		if (mode == Settings::RAY_SPAN::kFull) {
+			return { full, std::nullopt };
+		}
+
+		const auto range = SpanCache::GetSingleton()->Get(a_cell);
+		if (!range) {
+			return { full, std::nullopt };
+		}
+
+		const auto& origin = a_input.rayOrigin;
+		const auto  top = std::min(std::max(range->max, origin.z + headroom) + margin, full.from.z);
+		const auto  bottom = std::max(std::min(range->min, origin.z - headroom) - margin, full.to.z);
+
+		return {
+			{ { origin.x, origin.y, top }, { origin.x, origin.y, bottom } },
+			mode == Settings::RAY_SPAN::kTwoPhase ? std::optional(full) : std::nullopt
 		};
+	}
+
+	// by cell on the main thread, or by locked world on worker threads; the caller adds the stats
+	template <class Target>
+	std::optional<Engine::RayHit> CastRaySpans(Engine::IRayCaster* a_rayCaster, const Target& a_target, const RaySpans& a_spans, bool& a_fellBack)
+	{
+		auto hit = a_rayCaster->CastRay(a_target, a_spans.primary.from, a_spans.primary.to);
+		a_fellBack = !hit && a_spans.fallback;
+		if (a_fellBack) {
+			hit = a_rayCaster->CastRay(a_target, a_spans.fallback->from, a_spans.fallback->to);
+		}
+		return hit;
+	}
+
+	inline void AddQueryStats(const RaySpans& a_spans, bool a_fellBack, bool a_sync)
+	{
+		const auto tracker = Stats::Tracker::GetSingleton();
+		const auto queries = a_fellBack ? 2u : 1u;
 
-		if (!a_inPlayerFOV || RE::NiCamera::PointInFrustum(randPoint, RE::Main::WorldRootCamera(), 32.0f)) {
-			return randPoint;
+		tracker->Add(Stats::COUNTER::kRayQueries, queries);
+		if (a_sync) {
+			tracker->Add(Stats::COUNTER::kSyncRayQueries, queries);
+		}
+		if (a_fellBack) {
+			tracker->Add(Stats::COUNTER::kRayFallbacks);
 		}
 
-		return std::nullopt;
+		const auto length = a_spans.primary.GetLength() + (a_fellBack ? a_spans.fallback->GetLength() : 0.0f);
+		tracker->Add(Stats::COUNTER::kRayLength, static_cast<std::uint32_t>(length));
 	}
 
-	inline std::optional<Output> GenerateRayCast(RE::TESObjectCELL* a_cell, const Input& a_input)
+	// recent hit at the sample point, skipping the raycast entirely
+	template <class O>
+	std::optional<Output> LookupRayCast(const O&, const void* a_world, const Input& a_input)
 	{
-		if (!a_cell || a_cell != RE::PlayerCharacter::GetSingleton()->GetParentCell()) {
+		if constexpr (!O::heightCache) {
+			return std::nullopt;
+		}
+
+		const auto heightCache = HeightCache::GetSingleton();
+
+		// an actor may have walked onto the cached surface since
+		if (Actors::Index::GetSingleton()->IsNear(a_input.rayOrigin.x, a_input.rayOrigin.y, HeightCache::actorMargin)) {
 			return std::nullopt;
 		}
 
-		const auto bhkWorld = a_cell->GetbhkWorld();
-		if (!bhkWorld) {
+		const auto entry = heightCache->Get(a_world, a_input.rayOrigin);
+		if (!entry) {
 			return std::nullopt;
 		}
 
-		RE::NiPoint3 rayStart = a_input.rayOrigin;
-		RE::NiPoint3 rayEnd = a_input.rayOrigin;
+		Output output;
+		output.hitPos = { a_input.rayOrigin.x, a_input.rayOrigin.y, entry->height };
+		output.yaw = RNG::GetSingleton()->generate(-Engine::PI, Engine::PI);
+		output.surface = entry->surface;
+		output.hitWater = entry->water;
 
-		constexpr auto height = 9999.0f;
+		const auto tracker = Stats::Tracker::GetSingleton();
+		tracker->Add(Stats::COUNTER::kCacheHits);
+		tracker->Add(output.hitWater ? Stats::COUNTER::kWaterHits : Stats::COUNTER::kSurfaceHits);
 
-		rayStart.z += height;
-		rayEnd.z -= height;
-
-		RE::bhkPickData pickData{};
-
-		const auto havokWorldScale = RE::bhkWorld::GetWorldScale();
-		pickData.rayInput.from = rayStart * havokWorldScale;
-		pickData.rayInput.to = rayEnd * havokWorldScale;
-		pickData.rayInput.enableShapeCollectionFilter = false;
-		pickData.rayInput.filterInfo = RE::bhkCollisionFilter::GetSingleton()->GetNewSystemGroup() << 16 | std::to_underlying(RE::COL_LAYER::kLOS);
-
-		if (bhkWorld->PickObject(pickData); pickData.rayOutput.HasHit()) {
-			Output output;
-
-			const auto distance = rayEnd - rayStart;
-			output.hitPos = rayStart + (distance * pickData.rayOutput.hitFraction);
-
-			output.normal.SetEulerAnglesXYZ({ -0, -0, RNG::GetSingleton()->generate(-RE::NI_PI, RE::NI_PI) });
-
-			switch (static_cast<RE::COL_LAYER>(pickData.rayOutput.rootCollidable->broadPhaseHandle.collisionFilterInfo & 0x7F)) {
-			case RE::COL_LAYER::kCharController:
-			case RE::COL_LAYER::kBiped:
-			case RE::COL_LAYER::kDeadBip:
-			case RE::COL_LAYER::kBipedNoCC:
-				output.hitActor = true;
-				break;
-			default:
-				{
-					if (auto [inWater, waterHeight] = point_in_water(output.hitPos); inWater && waterHeight > output.hitPos.z) {
-						output.hitWater = true;
-						output.hitPos.z = waterHeight;
-					}
-				}
-				break;
+		return output;
+	}
+
+	// static surface from the worldspace exposure map, actors and anything not mapped yet still need a raycast
+	template <class O>
+	std::optional<Output> LookupExposure(const O&, const Input& a_input)
+	{
+		if constexpr (!O::exposureMaps) {
+			return std::nullopt;
+		}
+
+		// only exteriors have a worldspace map loaded
+		const auto sample = Exposure::Manager::GetSingleton()->Get(a_input.rayOrigin.x, a_input.rayOrigin.y);
+		if (!sample) {
+			return std::nullopt;
+		}
+
+		Output output;
+		output.hitPos = { a_input.rayOrigin.x, a_input.rayOrigin.y, sample->height };
+		output.yaw = RNG::GetSingleton()->generate(-Engine::PI, Engine::PI);
+		output.surface = sample->surface;
+
+		if (auto [inWater, waterHeight] = point_in_water(output.hitPos); inWater && waterHeight > output.hitPos.z) {
+			output.hitWater = true;
+			output.hitPos.z = waterHeight;
+		}
+
+		const auto tracker = Stats::Tracker::GetSingleton();
+		tracker->Add(Stats::COUNTER::kExposureHits);
+		tracker->Add(output.hitWater ? Stats::COUNTER::kWaterHits : Stats::COUNTER::kSurfaceHits);
+
+		return output;
+	}
+
+	// classifies a finished raycast and feeds the height cache, main thread only
+	template <class O>
+	std::optional<Output> ResolveRayCast(const O&, const void* a_world, const Input& a_input, const std::optional<Engine::RayHit>& a_hit)
+	{
+		const auto tracker = Stats::Tracker::GetSingleton();
+
+		if (!a_hit) {
+			tracker->Add(Stats::COUNTER::kMisses);
+			return std::nullopt;
+		}
+
+		Output output;
+
+		output.hitPos = a_hit->position;
+
+		output.yaw = RNG::GetSingleton()->generate(-Engine::PI, Engine::PI);
+
+		if (a_hit->type == Engine::HIT::kActor) {
+			output.hitActor = true;
+			tracker->Add(Stats::COUNTER::kActorHits);
+		} else {
+			if (auto [inWater, waterHeight] = point_in_water(output.hitPos); inWater && waterHeight > output.hitPos.z) {
+				output.hitWater = true;
+				output.hitPos.z = waterHeight;
+			} else {
+				output.surface = Surface::GetType(a_hit->material);
 			}
+			tracker->Add(output.hitWater ? Stats::COUNTER::kWaterHits : Stats::COUNTER::kSurfaceHits);
+		}
 
-			return output;
+		// actors and havok driven clutter move, only static hits are cached
+		if constexpr (O::heightCache) {
+			const auto heightCache = HeightCache::GetSingleton();
+			if (a_hit->type == Engine::HIT::kStatic) {
+				heightCache->Store(a_world, a_input.rayOrigin, output.hitPos.z, output.surface, output.hitWater);
+			} else {
+				heightCache->Invalidate(a_input.rayOrigin);
+			}
 		}
 
-		return std::nullopt;
+		return output;
 	}
+
+	template <class O>
+	std::optional<Output> GenerateRayCast(const O& a_options, Engine::Cell* a_cell, const Input& a_input)
+	{
+		if (!a_cell) {
+			return std::nullopt;
+		}
+
+		const Stats::ScopedTimer timer{ Stats::TIMER::kRayCast };
+
+		const auto rayCaster = Engine::Get().rayCaster;
+
+		const auto world = rayCaster->GetWorld(a_cell);
+		if (!world) {
+			return std::nullopt;
+		}
+
+		if (auto exposed = LookupExposure(a_options, a_input)) {
+			return exposed;
+		}
+
+		if (auto cached = LookupRayCast(a_options, world, a_input)) {
+			return cached;
+		}
+
+		const auto spans = GetRaySpans(a_options, a_cell, a_input);
+
+		bool                          fellBack = false;
+		std::optional<Engine::RayHit> hit;
+		{
+			const Stats::ScopedTimer queryTimer{ Stats::TIMER::kRayQuery };
+			hit = CastRaySpans(rayCaster, a_cell, spans, fellBack);
+		}
+		AddQueryStats(spans, fellBack, true);
+
+		return ResolveRayCast(a_options, world, a_input, hit);
+	}
+
+	// splash and ripple rays cast as one set from the splash hook, water hits go to ripples and the rest to splashes
+	// the ripple fast path places ripples without full raycasts, so there is nothing left to share
+	inline bool UseSharedRays(const Settings::RainHandle& a_rain)
+	{
+		const auto settings = Settings::Manager::GetSingleton()->Get();
+		return settings->sharedRays && !settings->rippleFastPath && a_rain->splash.enabled && a_rain->ripple.enabled;
+	}
+
+	// ripple rays requested by the ripple hook, cast with the next splash set
+	inline std::uint32_t pendingRippleRays{ 0 };
 }
 
 namespace Ripples
 {
-	struct Static
+	using namespace util;
+
+	struct FastPathStats
 	{
-		static inline bool showProceduralWater = false;
+		std::uint64_t raysSaved{ 0 };  // full length raycasts not issued
+		std::uint64_t probes{ 0 };     // short shelter probes issued instead
+		float         time{ 0.0f };
+	};
 
-		static void ToggleWaterRipples(RE::TESWaterSystem* a_waterSystem, bool a_enabled, float a_fadeAmount)
+	struct Dynamic
+	{
+		static inline RayCast::RateAccumulator emission;
+
+		static void Emit(const Settings::RainHandle& a_rain, Engine::Cell* a_cell, const Engine::Point3& a_playerPos, float a_delta)
 		{
-			float fadeAmount = a_fadeAmount;
-			if (a_enabled && a_fadeAmount > 0.0f) {
-				showProceduralWater = true;
-			} else {
-				if (!showProceduralWater) {
-					return;
-				}
-				showProceduralWater = false;
-				fadeAmount = 0.0f;
+			const auto rayCastCount = emission.Update(a_rain->ripple.rayCastRate * RayCast::Scheduler::GetSingleton()->GetScale(), a_delta);
+			if (rayCastCount == 0) {
+				return;
 			}
-			for (auto& waterObject : a_waterSystem->waterObjects) {
-				if (waterObject) {
-					if (const auto& rippleObject = waterObject->waterRippleObject; rippleObject) {
-						if (a_enabled) {
-							rippleObject->SetAppCulled(false);
-						} else {
-							rippleObject->SetAppCulled(true);
-						}
-
-						RE::BSVisit::TraverseScenegraphGeometries(rippleObject.get(), [&](RE::BSGeometry* a_geometry) -> RE::BSVisit::BSVisitControl {
-							using State = RE::BSGeometry::States;
-							using Feature = RE::BSShaderMaterial::Feature;
-
-							if (const auto effect = a_geometry->properties[State::kEffect].get()) {
-								if (const auto effectShaderProp = netimmerse_cast<RE::BSEffectShaderProperty*>(effect)) {
-									if (const auto material = static_cast<RE::BSEffectShaderMaterial*>(effectShaderProp->material)) {
-										material->baseColor.alpha = fadeAmount;
-									}
-								}
-							}
-
-							return RE::BSVisit::BSVisitControl::kContinue;
-						});
-					}
+
+			const auto rayCastRadius = a_rain->ripple.rayCastRadius;
+
+			if (Settings::Manager::GetSingleton()->Get()->rippleFastPath) {
+				fastPathStats.time += a_delta;
+				return AddDirectRipples(a_cell, a_rain, a_playerPos, rayCastCount);
+			}
+
+			// a frame's worth at most, in case the splash hook stops consuming them
+			if (RayCast::UseSharedRays(a_rain)) {
+				RayCast::pendingRippleRays = std::min(RayCast::pendingRippleRays + rayCastCount, rayCastCount * 2);
+				return;
+			}
+
+			const auto batch = RayCast::Batch::GetSingleton();
+
+			static std::vector<Engine::Point3> rayOrigins;
+			Sampler::GenerateDiskPoints(a_playerPos, rayCastRadius, rayCastCount, false, 0.0f, RNG::STREAM::kRipple, rayOrigins);
+			Stats::Tracker::GetSingleton()->Add(Stats::COUNTER::kRippleRays, static_cast<std::uint32_t>(rayOrigins.size()));
+
+			for (const auto& rayOrigin : rayOrigins) {
+				batch->Add(RayCast::Batch::TYPE::kRipple, a_cell, a_rain, rayOrigin);
+			}
+		}
+
+		// samples the flat water bounds inside the ripple radius directly, at the density full raycasts would hit them
+		// only a short shelter probe is cast per sample instead of a full length raycast per iteration
+		static void AddDirectRipples(Engine::Cell* a_cell, const Settings::RainHandle& a_rain, const Engine::Point3& a_playerPos, std::uint32_t a_rayCastCount)
+		{
+			static std::vector<Water::Index::Bound> bounds;
+			static std::vector<float>               boundsArea;
+
+			const auto radius = a_rain->ripple.rayCastRadius;
+
+			const auto index = Water::Index::GetSingleton();
+			index->Update(Engine::Get().waterSystem);
+			index->GetBounds(a_playerPos.x - radius, a_playerPos.y - radius, a_playerPos.x + radius, a_playerPos.y + radius, bounds);
+
+			fastPathStats.raysSaved += a_rayCastCount;
+
+			if (bounds.empty()) {
+				return;
+			}
+
+			float totalArea = 0.0f;
+			boundsArea.clear();
+			for (const auto& bound : bounds) {
+				totalArea += (bound.maxX - bound.minX) * (bound.maxY - bound.minY);
+				boundsArea.push_back(totalArea);
+			}
+
+			// hits expected from a_rayCastCount uniform disk samples, before rejecting the clipped corners outside the disk
+			const auto sampleCount = fastPathEmission.Add(static_cast<float>(a_rayCastCount) * totalArea / (Engine::PI * radius * radius));
+
+			const auto rng = RNG::GetSingleton(RNG::STREAM::kRipple);
+			const auto batch = RayCast::Batch::GetSingleton();
+
+			for (std::uint32_t i = 0; i < sampleCount; i++) {
+				const auto it = std::ranges::upper_bound(boundsArea, rng->generate() * totalArea);
+				const auto& bound = bounds[std::min<std::size_t>(std::distance(boundsArea.begin(), it), bounds.size() - 1)];
+
+				const Engine::Point3 point{
+					bound.minX + rng->generate() * (bound.maxX - bound.minX),
+					bound.minY + rng->generate() * (bound.maxY - bound.minY),
+					bound.z
+				};
+
+				if (const auto dx = point.x - a_playerPos.x, dy = point.y - a_playerPos.y; dx * dx + dy * dy > radius * radius) {
+					continue;
 				}
+
+				fastPathStats.probes++;
+				batch->Add(RayCast::Batch::TYPE::kRippleProbe, a_cell, a_rain, point);
 			}
 		}
+
+		static inline RayCast::RateAccumulator fastPathEmission;
+		static inline FastPathStats            fastPathStats;
 	};
+}
 
-	struct Dynamic
+namespace Splashes
+{
+	inline RayCast::RateAccumulator emission;
+	inline RayCast::RateAccumulator sharedEmission;
+
+	// one ray set for both consumers: each ray is kept for splashes and/or ripples with the probability that keeps that consumer's
+	// density inside its own radius where it was, so rays both want cost a single havok query
+	inline void Emit(const Settings::RainHandle& a_rain, Engine::Cell* a_cell, const Engine::Point3& a_playerPos, float a_delta)
 	{
-		static inline float rippleTimer = 0.0f;
-		static constexpr float rippleDelay = 0.01f;
+		const auto splashCount = emission.Update(a_rain->splash.rayCastRate * RayCast::Scheduler::GetSingleton()->GetScale(), a_delta);
+		const auto rippleCount = RayCast::UseSharedRays(a_rain) ? std::exchange(RayCast::pendingRippleRays, 0) : 0;
+		if (splashCount == 0 && rippleCount == 0) {
+			return;
+		}
 
-		static void ToggleWaterRipples(Rain* a_rain, RE::TESWaterSystem* a_waterSystem)
-		{
-			rippleTimer += RE::GetSecondsSinceLastFrame();
+		const auto settings = Settings::Manager::GetSingleton()->Get();
+		const auto splashRadius = a_rain->splash.rayCastRadius;
+		const auto rippleRadius = a_rain->ripple.rayCastRadius;
+		const auto rayCastRadius = rippleCount > 0 ? std::max(splashRadius, rippleRadius) : splashRadius;
 
-			if (rippleTimer > rippleDelay) {
-				rippleTimer = 0.0f;
+		const auto batch = RayCast::Batch::GetSingleton();
 
-				const auto player = RE::PlayerCharacter::GetSingleton();
-				const auto cell = player->GetParentCell();
-				if (!cell) {
-					return;
-				}
+		const auto falloff = settings->samplingFalloff;
+		const auto sector = settings->frustumSampling ? Sampler::GetCameraSector(a_playerPos, rayCastRadius) : std::nullopt;
 
-				const auto playerPos = RE::PlayerCharacter::GetSingleton()->GetPosition();
-
-				const auto rayCastRadius = a_rain->ripple.rayCastRadius;
-				const auto rayCastIterations = a_rain->ripple.rayCastIterations;
-
-				static const auto enableDebugMarker = Settings::Manager::GetSingleton()->enableDebugMarkerRipple;
-
-				for (std::size_t i = 0; i < rayCastIterations; i++) {
-					SKSE::GetTaskInterface()->AddTask([=] {
-						const RayCast::Input rayCastInput{
-							*RayCast::GenerateRandomPointAroundPlayer(rayCastRadius, playerPos, false),
-						};
-						if (const auto rayCastOutput = GenerateRayCast(cell, rayCastInput); rayCastOutput) {
-							if (rayCastOutput->hitWater) {
-								if (!enableDebugMarker) {
-									a_waterSystem->AddRipple(rayCastOutput->hitPos, a_rain->ripple.rippleDisplacementAmount * 0.0099999998f);
-								} else {
-									RE::BSTempEffectParticle::Spawn(cell, 1.6f, "MarkerX.nif", rayCastOutput->normal, rayCastOutput->hitPos, 0.5f, 7, nullptr);
-								}
-							}
-						}
-					});
-				}
+		// share of the sampled region inside each radius, under the falloff density
+		const auto getCoverage = [&](float a_radius) { return std::pow(a_radius / rayCastRadius, 2.0f - falloff); };
+
+		const auto splashTotal = static_cast<float>(splashCount) / getCoverage(splashRadius);
+		// ripple rays used to cover the whole disk, only the visible part is sampled now
+		const auto rippleTotal = static_cast<float>(rippleCount) / getCoverage(rippleRadius) * (sector ? sector->halfAngle / Engine::PI : 1.0f);
+		const auto total = std::max(splashTotal, rippleTotal);
+
+		const auto rayCastCount = sharedEmission.Add(total);
+		if (rayCastCount == 0) {
+			return;
+		}
+
+		static std::vector<Engine::Point3> rayOrigins;
+		Engine::Point3                     samplingOrigin = a_playerPos;
+		if (sector) {
+			samplingOrigin = sector->origin;
+			Sampler::GeneratePoints(*sector, rayCastRadius, rayCastCount, settings->samplingPattern, falloff, rayOrigins);
+		} else {
+			Sampler::GenerateDiskPoints(a_playerPos, rayCastRadius, rayCastCount, true, falloff, util::RNG::STREAM::kSplash, rayOrigins);
+		}
+
+		const auto rng = util::RNG::GetSingleton(util::RNG::STREAM::kSplash);
+		const auto keep = [&](float a_share) {
+			return a_share >= 1.0f || rng->generate() < a_share;
+		};
+
+		std::uint32_t splashRays = 0;
+		std::uint32_t rippleRays = 0;
+		std::uint32_t sharedRays = 0;
+
+		for (const auto& rayOrigin : rayOrigins) {
+			const auto distance = std::hypot(rayOrigin.x - samplingOrigin.x, rayOrigin.y - samplingOrigin.y);
+
+			const bool splash = splashTotal > 0.0f && distance <= splashRadius && keep(splashTotal / total);
+			const bool ripple = rippleTotal > 0.0f && distance <= rippleRadius && keep(rippleTotal / total);
+
+			if (splash && ripple) {
+				sharedRays++;
+			}
+
+			if (splash) {
+				splashRays++;
+				const auto scale = Sampler::GetScaleCompensation(distance, splashRadius, falloff, settings->samplingScaleLimit);
+				batch->Add(ripple ? RayCast::Batch::TYPE::kShared : RayCast::Batch::TYPE::kSplash, a_cell, a_rain, rayOrigin, scale);
+			} else if (ripple) {
+				batch->Add(RayCast::Batch::TYPE::kRipple, a_cell, a_rain, rayOrigin);
+			}
+
+			if (ripple) {
+				rippleRays++;
 			}
 		}
-	};
+
+		const auto tracker = Stats::Tracker::GetSingleton();
+		tracker->Add(Stats::COUNTER::kSplashRays, splashRays);
+		tracker->Add(Stats::COUNTER::kRippleRays, rippleRays);
+		tracker->Add(Stats::COUNTER::kSharedRays, sharedRays);
+		tracker->Add(Stats::COUNTER::kFrustumRejects, rayCastCount - static_cast<std::uint32_t>(rayOrigins.size()));
+	}
+
+	inline RayCast::RateAccumulator actorEmission;
+
+	// samples the top of the actors' bounds directly, each point only needs a short shelter probe instead of a full raycast that rarely hits anyone
+	inline void EmitActors(const Settings::RainHandle& a_rain, Engine::Cell* a_cell, const Engine::Point3& a_playerPos, float a_delta)
+	{
+		static std::vector<Actors::Bound> bounds;
+		Actors::Index::GetSingleton()->GetBounds(a_playerPos.x, a_playerPos.y, a_rain->splash.rayCastRadius, bounds);
+
+		const auto frustum = Settings::Manager::GetSingleton()->Get()->frustumSampling ? Engine::Get().camera->GetFrustum() : std::nullopt;
+		if (frustum) {
+			std::erase_if(bounds, [&](const Actors::Bound& a_bound) {
+				return !frustum->Contains({ a_bound.position.x, a_bound.position.y, a_bound.position.z + a_bound.height }, a_bound.radius);
+			});
+		}
+
+		const auto count = actorEmission.Update(a_rain->splash.actorRate * static_cast<float>(bounds.size()) * RayCast::Scheduler::GetSingleton()->GetScale(), a_delta);
+		if (count == 0 || bounds.empty()) {
+			return;
+		}
+
+		const auto rng = util::RNG::GetSingleton(util::RNG::STREAM::kSplash);
+		const auto batch = RayCast::Batch::GetSingleton();
+		const auto actors = Engine::Get().actors;
+
+		for (std::uint32_t i = 0; i < count; i++) {
+			const auto& sampled = bounds[std::min(static_cast<std::size_t>(rng->generate() * static_cast<float>(bounds.size())), bounds.size() - 1)];
+
+			// the index only refreshes a few actors per frame, running actors would leave their splashes behind
+			Actors::Bound bound;
+			if (!Actors::Index::GetBound(actors, sampled.handle, bound)) {
+				continue;
+			}
+
+			// uniform over the top disk, dropped onto a hemisphere cap so shoulders splash lower than the head
+			const auto angle = rng->generate(-Engine::PI, Engine::PI);
+			const auto distance = bound.radius * std::sqrt(rng->generate());
+			const Engine::Point3 point{
+				bound.position.x + distance * std::cos(angle),
+				bound.position.y + distance * std::sin(angle),
+				bound.position.z + bound.height - (bound.radius - std::sqrt(bound.radius * bound.radius - distance * distance))
+			};
+
+			batch->Add(RayCast::Batch::TYPE::kActorProbe, a_cell, a_rain, point);
+		}
+	}
 }
@@ -0,0 +1,166 @@
+#include "WaterIndex.h"
+
+namespace Water
+{
+	void Index::Update(const Engine::IWaterSystem* a_waterSystem)
+	{
+		if (!a_waterSystem) {
+			return;
+		}
+
+		if (const auto newSignature = a_waterSystem->GetSignature(); newSignature != signature || generation == 0) {
+			signature = newSignature;
+			Rebuild(a_waterSystem);
+		}
+	}
+
+	void Index::Rebuild(const Engine::IWaterSystem* a_waterSystem)
+	{
+		bounds.clear();
+		visited.clear();
+		cellStart.clear();
+		cellBounds.clear();
+		width = 0;
+		height = 0;
+
+		generation++;
+
+		float minX = std::numeric_limits<float>::max();
+		float minY = std::numeric_limits<float>::max();
+		float maxX = std::numeric_limits<float>::lowest();
+		float maxY = std::numeric_limits<float>::lowest();
+
+		a_waterSystem->ForEachBound([&](const Engine::Point3& a_center, const Engine::Point3& a_size) {
+			if (a_size.z <= 10.0f) {  //avoid sloped water
+				const Bound flatBound{ a_center.x - a_size.x, a_center.y - a_size.y, a_center.x + a_size.x, a_center.y + a_size.y, a_center.z };
+
+				minX = std::min(minX, flatBound.minX);
+				minY = std::min(minY, flatBound.minY);
+				maxX = std::max(maxX, flatBound.maxX);
+				maxY = std::max(maxY, flatBound.maxY);
+
+				bounds.push_back(flatBound);
+			}
+		});
+
+		if (bounds.empty()) {
+			return;
+		}
+
+		// ~2 cells per bound on average, so most cells hold only a handful of entries
+		const auto cellsPerAxis = std::clamp(static_cast<std::uint32_t>(std::ceil(std::sqrt(static_cast<float>(bounds.size()) * 2.0f))), 1u, maxCellsPerAxis);
+
+		width = cellsPerAxis;
+		height = cellsPerAxis;
+		originX = minX;
+		originY = minY;
+		invCellSizeX = static_cast<float>(width) / std::max(maxX - minX, 1.0f);
+		invCellSizeY = static_cast<float>(height) / std::max(maxY - minY, 1.0f);
+
+		// counting pass, then prefix sum, then fill (CSR layout)
+		cellStart.assign(static_cast<std::size_t>(width) * height + 1, 0);
+
+		const auto for_each_cell = [&](const Bound& a_bound, auto&& a_func) {
+			const auto x0 = GetCellX(a_bound.minX);
+			const auto x1 = GetCellX(a_bound.maxX);
+			const auto y0 = GetCellY(a_bound.minY);
+			const auto y1 = GetCellY(a_bound.maxY);
+			for (auto y = y0; y <= y1; y++) {
+				for (auto x = x0; x <= x1; x++) {
+					a_func(y * width + x);
+				}
+			}
+		};
+
+		for (const auto& bound : bounds) {
+			for_each_cell(bound, [&](std::uint32_t a_cell) {
+				cellStart[a_cell + 1]++;
+			});
+		}
+		for (std::size_t i = 1; i < cellStart.size(); i++) {
+			cellStart[i] += cellStart[i - 1];
+		}
+
+		cellBounds.resize(cellStart.back());
+		visited.assign(bounds.size(), visitStamp);
+
+		std::vector<std::uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+		for (std::uint32_t i = 0; i < bounds.size(); i++) {
+			for_each_cell(bounds[i], [&](std::uint32_t a_cell) {
+				cellBounds[cursor[a_cell]++] = i;
+			});
+		}
+
+		logger::debug("Rebuilt water index : {} flat bounds, {}x{} grid", bounds.size(), width, height);
+	}
+
+	std::uint32_t Index::GetCellX(float a_x) const
+	{
+		const auto cell = static_cast<std::int32_t>((a_x - originX) * invCellSizeX);
+		return static_cast<std::uint32_t>(std::clamp(cell, 0, static_cast<std::int32_t>(width) - 1));
+	}
+
+	std::uint32_t Index::GetCellY(float a_y) const
+	{
+		const auto cell = static_cast<std::int32_t>((a_y - originY) * invCellSizeY);
+		return static_cast<std::uint32_t>(std::clamp(cell, 0, static_cast<std::int32_t>(height) - 1));
+	}
+
+	std::optional<float> Index::GetWaterHeight(float a_x, float a_y) const
+	{
+		if (bounds.empty()) {
+			return std::nullopt;
+		}
+
+		const auto cell = GetCellY(a_y) * width + GetCellX(a_x);
+		for (auto i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+			const auto& bound = bounds[cellBounds[i]];
+			if (!(a_x < bound.minX || a_x > bound.maxX || a_y < bound.minY || a_y > bound.maxY)) {
+				return bound.z;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	void Index::GetBounds(float a_minX, float a_minY, float a_maxX, float a_maxY, std::vector<Bound>& a_bounds)
+	{
+		a_bounds.clear();
+
+		if (bounds.empty()) {
+			return;
+		}
+
+		visitStamp++;
+
+		const auto x0 = GetCellX(a_minX);
+		const auto x1 = GetCellX(a_maxX);
+		const auto y0 = GetCellY(a_minY);
+		const auto y1 = GetCellY(a_maxY);
+
+		for (auto y = y0; y <= y1; y++) {
+			for (auto x = x0; x <= x1; x++) {
+				const auto cell = y * width + x;
+				for (auto i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+					const auto boundIdx = cellBounds[i];
+					if (visited[boundIdx] == visitStamp) {
+						continue;
+					}
+					visited[boundIdx] = visitStamp;
+
+					const auto& bound = bounds[boundIdx];
+					const Bound clipped{
+						std::max(bound.minX, a_minX),
+						std::max(bound.minY, a_minY),
+						std::min(bound.maxX, a_maxX),
+						std::min(bound.maxY, a_maxY),
+						bound.z
+					};
+					if (clipped.minX < clipped.maxX && clipped.minY < clipped.maxY) {
+						a_bounds.push_back(clipped);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Engine.h"
+
+namespace Water
+{
+	// 2D uniform grid over the flat water multibounds, rebuilt whenever the water system's object list changes
+	class Index : public ISingleton<Index>
+	{
+	public:
+		struct Bound
+		{
+			float minX;
+			float minY;
+			float maxX;
+			float maxY;
+			float z;
+		};
+
+		void Update(const Engine::IWaterSystem* a_waterSystem);
+
+		[[nodiscard]] std::optional<float> GetWaterHeight(float a_x, float a_y) const;
+		[[nodiscard]] std::uint32_t        GetGeneration() const { return generation; }
+
+		// flat bounds overlapping the rect, clipped to it
+		void GetBounds(float a_minX, float a_minY, float a_maxX, float a_maxY, std::vector<Bound>& a_bounds);
+
+	private:
+
+		void Rebuild(const Engine::IWaterSystem* a_waterSystem);
+
+		[[nodiscard]] std::uint32_t GetCellX(float a_x) const;
+		[[nodiscard]] std::uint32_t GetCellY(float a_y) const;
+
+		static constexpr std::uint32_t maxCellsPerAxis{ 64 };
+
+		std::vector<Bound>         bounds;
+		std::vector<std::uint32_t> cellStart;   // width * height + 1 offsets into cellBounds
+		std::vector<std::uint32_t> cellBounds;  // bound indices per cell, ascending to keep the scan's first-hit order
+		float                      originX{ 0.0f };
+		float                      originY{ 0.0f };
+		float                      invCellSizeX{ 0.0f };
+		float                      invCellSizeY{ 0.0f };
+		std::uint32_t              width{ 0 };
+		std::uint32_t              height{ 0 };
+		std::vector<std::uint32_t> visited;  // per bound stamp, so bounds spanning several cells are returned once
+		std::uint32_t              visitStamp{ 0 };
+		std::size_t                signature{ 0 };
+		std::uint32_t              generation{ 0 };
+	};
+}
@@ -1,4 +1,5 @@
 #include "Debug.h"
+#include "Exposure.h"
 #include "Hooks.h"
 #include "Settings.h"
 
@@ -10,6 +11,8 @@ void MessageHandler(SKSE::MessagingInterface::Message* a_message)
 		logger::info("{:*^30}", "HOOKS");
 		Hooks::Install();
 		Debug::Install();
+	} else if (a_message->type == SKSE::MessagingInterface::kSaveGame) {
+		Exposure::Manager::GetSingleton()->Save();
 	}
 }
 